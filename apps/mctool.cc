@@ -0,0 +1,145 @@
+//// Compiled command line front end for the tutorial macros
+//// Build it with cmake (see CMakeLists.txt), then e.g.
+//// ./build/mctool convert gntp.0.ghep.root 4 "flat profile=analysis"
+//// ./build/mctool kinematics gntp.0.ghep_converted.root 8
+//// ./build/mctool osc gntp.0.ghep_converted.root 810 2.8
+//// ./build/mctool reco gntp.0.ghep_converted.root
+//// ./build/mctool xsec xsec.root nu_mu_Ar40
+//// Every subcommand runs the same code as the macro of the same name, only
+//// compiled with -O3; plots are written to the same files as the macros do.
+
+#include <TROOT.h>
+#include <TStopwatch.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// Entry points of the macros, compiled into libmccore
+#ifdef MCTOOL_HAS_GENIE
+void read_genie_convert_root(const char* infile, int nthreads, const char* opt);
+void read_genie_convert_campaign(const char* pattern, int nworkers,
+                                 const char* opt, const char* mergedOut);
+#endif
+void plot_genie_kinematics(const char* filename, int nthreads, const char* checkpoint, int nreplicas);
+void plot_genie_kinematics_scaling(const char* filename, int maxThreads);
+void fill_kinematics_sparse(const char* filename, int nthreads, const char* output, double capMB);
+void project_kinematics_sparse(const char* sparseFile, const char* axes);
+void scan_nucleon_mass(const char* filename, int nmass, double mmin, double mmax, int nthreads,
+                       const char* output);
+void osc_approx_matter(const char* filename, double baseline_km, double density, bool normalize,
+                       bool cacheWeights, const char* fluxFile, double pot, int nreplicas);
+void osc_grid_scan(const char* filename, int ns23, int ndm31, int ndcp, int nthreads,
+                   double baseline_km, double density, double exposure, const char* output);
+void osc_earth(const char* filename, int nupdg, int nE, int nCos, int nthreads, double Emin, double Emax);
+void reconstruct_energy(const char* filename, int nthreads, const char* checkpoint,
+                        double baseline_km, double density, const char* fluxFile, double pot, int nuniverses,
+                        int nreplicas);
+void unfold_energy(const char* filename, int nbins, int iterations, int nthreads);
+void extract_xsec(const char* file, const char* directory);
+void read_layouts(const char* files);
+
+void usage()
+{
+    cout << "usage: mctool <command> [arguments]\n"
+#ifdef MCTOOL_HAS_GENIE
+         << "  convert    <ghep file> [threads=1] [options]\n"
+         << "  campaign   <pattern> [workers=4] [options] [merged output]\n"
+#endif
+         << "  kinematics <converted file> [threads=1] [checkpoint file] [bootstrap replicas=0]\n"
+         << "  kinematics-scaling <converted file> [max threads=all cores]\n"
+         << "  kinematics-sparse <converted file> [threads=1] [output=kinematics_sparse.root] [cap MB=2000]\n"
+         << "  project    <sparse file> <axes, e.g. Enu:Q2>\n"
+         << "  mass-scan  <converted file> [n masses=50] [min GeV=0.80] [max GeV=0.98] [threads=1]\n"
+         << "             [output=kinematics_mass_scan.root]\n"
+         << "  osc        <converted file> [baseline km=810] [density g/cm3=2.8] [normalize=1] [cache weights=0]\n"
+         << "             [flux file] [POT=1e21] [bootstrap replicas=0]\n"
+         << "  osc-scan   <converted file> [n s23=40] [n dm31=40] [n dCP=36] [threads=all cores]\n"
+         << "             [baseline km=810] [density g/cm3=2.8] [exposure=1000] [output=osc_grid_scan.root]\n"
+         << "  earth      <converted file or -> [nu pdg=14] [n E=200] [n cos=200] [threads=all cores]\n"
+         << "             [Emin GeV=0.5] [Emax GeV=50]\n"
+         << "  reco       <converted file> [threads=1] [checkpoint file] [baseline km] [density g/cm3=2.8]\n"
+         << "             [flux file] [POT=1e21] [universes=0] [bootstrap replicas=0]\n"
+         << "  unfold     <converted file> [n bins=500] [iterations=4] [threads=all cores]\n"
+         << "  xsec       <spline root file> <directory>\n"
+         << "  layouts    <file1,file2,...>\n";
+}
+
+// Optional positional argument k, or the default
+const char* arg(int argc, char** argv, int k, const char* def)
+{
+    return k < argc ? argv[k] : def;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        usage();
+        return argc < 2 || strcmp(argv[1], "help") == 0 ? 0 : 1;
+    }
+    gROOT->SetBatch(true);
+
+    const char* cmd = argv[1];
+    TStopwatch timer;
+#ifdef MCTOOL_HAS_GENIE
+    if (strcmp(cmd, "convert") == 0) {
+        read_genie_convert_root(argv[2], atoi(arg(argc, argv, 3, "1")), arg(argc, argv, 4, ""));
+    } else if (strcmp(cmd, "campaign") == 0) {
+        read_genie_convert_campaign(argv[2], atoi(arg(argc, argv, 3, "4")),
+                                    arg(argc, argv, 4, ""), arg(argc, argv, 5, ""));
+    } else
+#endif
+    if (strcmp(cmd, "kinematics") == 0) {
+        plot_genie_kinematics(argv[2], atoi(arg(argc, argv, 3, "1")), arg(argc, argv, 4, ""),
+                              atoi(arg(argc, argv, 5, "0")));
+    } else if (strcmp(cmd, "kinematics-scaling") == 0) {
+        plot_genie_kinematics_scaling(argv[2], atoi(arg(argc, argv, 3, "0")));
+    } else if (strcmp(cmd, "kinematics-sparse") == 0) {
+        fill_kinematics_sparse(argv[2], atoi(arg(argc, argv, 3, "1")),
+                               arg(argc, argv, 4, "kinematics_sparse.root"), atof(arg(argc, argv, 5, "2000")));
+    } else if (strcmp(cmd, "project") == 0) {
+        project_kinematics_sparse(argv[2], arg(argc, argv, 3, "Enu:Q2"));
+    } else if (strcmp(cmd, "mass-scan") == 0) {
+        scan_nucleon_mass(argv[2], atoi(arg(argc, argv, 3, "50")), atof(arg(argc, argv, 4, "0.80")),
+                          atof(arg(argc, argv, 5, "0.98")), atoi(arg(argc, argv, 6, "1")),
+                          arg(argc, argv, 7, "kinematics_mass_scan.root"));
+    } else if (strcmp(cmd, "osc") == 0) {
+        osc_approx_matter(argv[2], atof(arg(argc, argv, 3, "810")),
+                          atof(arg(argc, argv, 4, "2.8")), atoi(arg(argc, argv, 5, "1")) != 0,
+                          atoi(arg(argc, argv, 6, "0")) != 0, arg(argc, argv, 7, ""), atof(arg(argc, argv, 8, "1e21")),
+                          atoi(arg(argc, argv, 9, "0")));
+    } else if (strcmp(cmd, "osc-scan") == 0) {
+        osc_grid_scan(argv[2], atoi(arg(argc, argv, 3, "40")), atoi(arg(argc, argv, 4, "40")),
+                      atoi(arg(argc, argv, 5, "36")), atoi(arg(argc, argv, 6, "0")),
+                      atof(arg(argc, argv, 7, "810")), atof(arg(argc, argv, 8, "2.8")),
+                      atof(arg(argc, argv, 9, "1000")), arg(argc, argv, 10, "osc_grid_scan.root"));
+    } else if (strcmp(cmd, "earth") == 0) {
+        osc_earth(strcmp(argv[2], "-") == 0 ? "" : argv[2], atoi(arg(argc, argv, 3, "14")),
+                  atoi(arg(argc, argv, 4, "200")), atoi(arg(argc, argv, 5, "200")), atoi(arg(argc, argv, 6, "0")),
+                  atof(arg(argc, argv, 7, "0.5")), atof(arg(argc, argv, 8, "50")));
+    } else if (strcmp(cmd, "reco") == 0) {
+        reconstruct_energy(argv[2], atoi(arg(argc, argv, 3, "1")), arg(argc, argv, 4, ""),
+                           atof(arg(argc, argv, 5, "0")), atof(arg(argc, argv, 6, "2.8")),
+                           arg(argc, argv, 7, ""), atof(arg(argc, argv, 8, "1e21")),
+                           atoi(arg(argc, argv, 9, "0")), atoi(arg(argc, argv, 10, "0")));
+    } else if (strcmp(cmd, "unfold") == 0) {
+        unfold_energy(argv[2], atoi(arg(argc, argv, 3, "500")), atoi(arg(argc, argv, 4, "4")),
+                      atoi(arg(argc, argv, 5, "0")));
+    } else if (strcmp(cmd, "xsec") == 0) {
+        if (argc < 4) {
+            usage();
+            return 1;
+        }
+        extract_xsec(argv[2], argv[3]);
+    } else if (strcmp(cmd, "layouts") == 0) {
+        read_layouts(argv[2]);
+    } else {
+        cerr << "Unknown command " << cmd << endl;
+        usage();
+        return 1;
+    }
+    timer.Stop();
+    printf("mctool %s: %.2f s real, %.2f s cpu\n", cmd, timer.RealTime(), timer.CpuTime());
+    return 0;
+}
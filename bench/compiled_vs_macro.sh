@@ -0,0 +1,43 @@
+#!/bin/bash
+## Time the same analysis through the macro path and the compiled mctool
+## Usage (inside the apptainer, after building mctool with cmake):
+##   bench/compiled_vs_macro.sh gntp.0.ghep_converted.root [build dir=build]
+## For kinematics, osc and reco this runs
+##   root -b -q 'macro.cc("file")'    interpreted by cling
+##   root -b -q 'macro.cc+("file")'   ACLiC, default flags (compiled once before timing)
+##   mctool <command> file            -O3 executable
+## and prints the wall time of each plus the speedup of mctool over both.
+## Plots are written into a scratch directory so the working tree stays clean.
+
+input=$(readlink -f "$1")
+build=$(readlink -f "${2:-build}")
+top=$(cd "$(dirname "$0")/.." && pwd)
+if [ ! -f "$input" ] || [ ! -x "$build/mctool" ]; then
+    echo "usage: $0 <converted file> [build dir]  (mctool must be built first)"
+    exit 1
+fi
+
+scratch=$(mktemp -d)
+cd "$scratch"
+
+seconds() {
+    local t0=$(date +%s.%N)
+    "$@" > /dev/null 2>&1
+    local t1=$(date +%s.%N)
+    echo "$t1 - $t0" | bc
+}
+
+printf "%-12s %10s %10s %10s %10s %10s\n" "command" "cling[s]" "aclic[s]" "mctool[s]" "x cling" "x aclic"
+for pair in kinematics:proj2/plot_genie_kinematics osc:proj3/osc_approx_matter reco:proj4/reconstruct_energy; do
+    cmd=${pair%%:*}
+    macro=$top/${pair#*:}.cc
+    # build the ACLiC library outside of the timing
+    root -l -b -q -e ".L $macro+" > /dev/null 2>&1
+    tcling=$(seconds root -l -b -q "$macro(\"$input\")")
+    taclic=$(seconds root -l -b -q "$macro+(\"$input\")")
+    ttool=$(seconds "$build/mctool" $cmd "$input")
+    printf "%-12s %10.2f %10.2f %10.2f %10.1f %10.1f\n" $cmd $tcling $taclic $ttool \
+        $(echo "$tcling / $ttool" | bc -l) $(echo "$taclic / $ttool" | bc -l)
+done
+
+rm -rf "$scratch"
@@ -0,0 +1,100 @@
+//// Microbenchmark of the kinematics kernels: scalar ComputeLeptonKinematics
+//// called event by event against the batched SoA kernel, which
+//// scan_nucleon_mass in proj2 uses.
+//// root -l -b
+//// root [0] gSystem->SetFlagsOpt("-O3 -fno-math-errno -fno-trapping-math")
+//// root [1] .L kinematics_kernel.cc+O
+//// root [2] kinematics_kernel(10000000)
+//// or without ROOT (it only uses the common headers)
+//// g++ -O3 -fno-math-errno -fno-trapping-math -std=c++17 -DKINEMATICS_KERNEL_MAIN kinematics_kernel.cc -o kinematics_kernel
+//// ./kinematics_kernel 10000000
+//// Add -DMC_TUTORIAL_NO_STD_SIMD to time the auto-vectorized fallback that
+//// gcc 9 uses, and -march=native for the widest vectors. With few events
+//// (e.g. 4096 and repeat=2000) the data stays in cache and the arithmetic
+//// is measured; with millions of events both versions are mostly limited
+//// by memory bandwidth, and with AVX-512 the simd version can be the
+//// slower one there.
+//// Events are random neutrino/lepton pairs, including some with omega < 0
+//// and Q2 < 0 so the masked cases are exercised. Prints the time per event
+//// for both versions, the speedup and the largest difference.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "../common/kinematics.h"
+#include "../common/kinematics_batch.h"
+
+void kinematics_kernel(long nevents = 10000000, int repeat = 5)
+{
+    // Random events, fixed seed so every run sees the same input
+    KinematicsBatch b;
+    b.Resize(nevents);
+    std::mt19937_64 rng(12345);
+    std::uniform_real_distribution<double> uni(0, 1);
+    for (long i = 0; i < nevents; i++) {
+        double E = 0.2 + 10*uni(rng);
+        double cth = 2*uni(rng) - 1, phi = 2*M_PI*uni(rng), sth = std::sqrt(1 - cth*cth);
+        double El = E*(0.05 + 1.0*uni(rng));  // sometimes above E: omega < 0
+        double pl = std::sqrt(std::fmax(El*El - 0.1057*0.1057, 0));
+        b.nuE[i] = E; b.nuPx[i] = 0; b.nuPy[i] = 0; b.nuPz[i] = E;
+        b.lepE[i] = El; b.lepPx[i] = pl*sth*std::cos(phi); b.lepPy[i] = pl*sth*std::sin(phi); b.lepPz[i] = pl*cth;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    auto seconds = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double>(b - a).count();
+    };
+
+    // Scalar: one call per event, results stored like the batch does
+    std::vector<double> sq3(nevents), somega(nevents), sQ2(nevents), sx(nevents), sy(nevents);
+    double tScalar = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        Clock::time_point t0 = Clock::now();
+        for (long i = 0; i < nevents; i++) {
+            LeptonKinematics k = ComputeLeptonKinematics(b.nuE[i], b.nuPx[i], b.nuPy[i], b.nuPz[i],
+                                                         b.lepE[i], b.lepPx[i], b.lepPy[i], b.lepPz[i]);
+            sq3[i] = k.q3; somega[i] = k.omega; sQ2[i] = k.Q2; sx[i] = k.x; sy[i] = k.y;
+        }
+        tScalar = std::fmin(tScalar, seconds(t0, Clock::now()));
+    }
+
+    double tBatch = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        Clock::time_point t0 = Clock::now();
+        ComputeLeptonKinematicsBatch(b);
+        tBatch = std::fmin(tBatch, seconds(t0, Clock::now()));
+    }
+
+    double maxDiff = 0;
+    long nclamped = 0;
+    for (long i = 0; i < nevents; i++) {
+        maxDiff = std::fmax(maxDiff, std::fabs(sq3[i] - b.q3[i]));
+        maxDiff = std::fmax(maxDiff, std::fabs(somega[i] - b.omega[i]));
+        maxDiff = std::fmax(maxDiff, std::fabs(sQ2[i] - b.Q2[i]));
+        maxDiff = std::fmax(maxDiff, std::fabs(sx[i] - b.x[i]) / std::fmax(1, std::fabs(sx[i])));
+        maxDiff = std::fmax(maxDiff, std::fabs(sy[i] - b.y[i]) / std::fmax(1, std::fabs(sy[i])));
+        if (b.omega[i] <= 0 || b.Q2[i] == 0) nclamped++;
+    }
+
+#ifdef MC_TUTORIAL_HAVE_STD_SIMD
+    const char* kernel = "std::experimental::simd";
+#else
+    const char* kernel = "auto-vectorized loop";
+#endif
+    printf("%ld events, %ld with omega <= 0 or Q2 clamped, batch kernel: %s\n", nevents, nclamped, kernel);
+    printf("%-8s %12s %14s\n", "version", "ns/event", "Mevents/s");
+    printf("%-8s %12.2f %14.1f\n", "scalar", 1e9*tScalar/nevents, nevents/tScalar/1e6);
+    printf("%-8s %12.2f %14.1f\n", "batch", 1e9*tBatch/nevents, nevents/tBatch/1e6);
+    printf("speedup %.2f, largest difference %.2g\n", tScalar/tBatch, maxDiff);
+}
+
+#ifdef KINEMATICS_KERNEL_MAIN
+int main(int argc, char** argv)
+{
+    kinematics_kernel(argc > 1 ? atol(argv[1]) : 10000000, argc > 2 ? atoi(argv[2]) : 5);
+    return 0;
+}
+#endif
@@ -0,0 +1,60 @@
+//// Compare converted files written with different layouts and formats
+//// root -l 'read_layouts.cc("gntp.0.ghep_vector.root,gntp.0.ghep_flat.root,gntp.0.ghep_rntuple.root")'
+//// Convert the same ghep file once per layout or format, e.g.
+////   genie 'read_genie_convert_root.cc("gntp.0.ghep.root", 1, "")'
+////   genie 'read_genie_convert_root.cc("gntp.0.ghep.root", 1, "flat float")'
+////   genie 'read_genie_convert_root.cc("gntp.0.ghep.root", 1, "rntuple")'
+//// renaming the _converted.root output in between. For every file this
+//// prints the stored bytes per event and the throughput of a full read of
+//// all particles through ConvertedReader.
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TString.h>
+#include <TObjArray.h>
+#include <TObjString.h>
+#include <TStopwatch.h>
+#include <iostream>
+
+#include "../common/converted_reader.h"
+
+using namespace std;
+
+void read_layouts(const char* files)
+{
+    TObjArray* names = TString(files).Tokenize(",");
+    printf("%-40s %8s %12s %14s %12s %10s\n", "file", "layout",
+           "bytes/evt", "part.bytes/evt", "events/s", "MB/s");
+
+    for (int k = 0; k < names->GetEntries(); k++) {
+        TString name = ((TObjString*)names->At(k))->GetString().Strip(TString::kBoth);
+        ConvertedReader reader(name);
+        if (!reader.IsOpen()) continue;
+
+        Long64_t N = reader.GetEntries();
+        if (N == 0) continue;
+        double fileBytes = reader.GetFile()->GetSize();
+        // RNTuple keeps events and particles together; count the whole file
+        double partBytes = reader.IsNtuple() ? fileBytes : reader.GetParticleTree()->GetZipBytes();
+
+        // Read every particle so that no column is skipped by the comparison
+        TStopwatch timer;
+        double sum = 0;
+        for (Long64_t i = 0; i < N; i++) {
+            reader.GetEntry(i);
+            for (int j = 0; j < reader.NParticles(); j++) {
+                if (reader.Status(j) == 1)
+                    sum += reader.Energy(j) + reader.Px(j) + reader.Py(j) + reader.Pz(j);
+            }
+        }
+        double t = timer.RealTime();
+
+        TString layout = reader.IsNtuple() ? "rntuple" : (reader.IsFlat() ? "flat" : "vector");
+        if (reader.IsFloat()) layout += "/F";
+        printf("%-40s %8s %12.1f %14.1f %12.0f %10.1f\n", name.Data(), layout.Data(),
+               fileBytes/N, partBytes/N, t > 0 ? N/t : 0,
+               t > 0 ? fileBytes/t/1e6 : 0);
+        if (sum == 0) cout << "  (no final state particles read)" << endl;
+    }
+    delete names;
+}
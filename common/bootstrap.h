@@ -0,0 +1,157 @@
+//// Statistical uncertainties by Poisson bootstrap, filled in the same pass
+//// as the nominal histograms. Every event enters each of K replicas with
+//// a weight drawn from Poisson(1); the spread of a bin over the replicas
+//// estimates its statistical variance, and the joint spread of two bins
+//// their covariance. This holds for any event weights and for bins
+//// correlated because one event fills several of them.
+////
+//// The Poisson numbers come from a counter-based generator: replica k of
+//// entry i is a hash of (seed, i, k), with no generator state. Results are
+//// therefore the same for any number of threads, any split of the entries
+//// and for checkpointed runs that add new entries later.
+////
+//// The replicas of a 1D histogram are a TH2D with the same x binning and
+//// one row of bins per replica (y bin k + 1 is replica k), so they merge
+//// and save like any other histogram. HistEngine::BookBootstrap fills them
+//// for a booked histogram; a hand-written loop calls
+//// PoissonReplicaWeights once per event and FillReplicas per histogram.
+#ifndef MC_TUTORIAL_BOOTSTRAP_H
+#define MC_TUTORIAL_BOOTSTRAP_H
+
+#include <TH1.h>
+#include <TH1D.h>
+#include <TH2D.h>
+#include <TString.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+const uint64_t kBootstrapSeed = 20250325;
+
+// SplitMix64 finaliser
+inline uint64_t BootstrapMix(uint64_t x)
+{
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Cumulative Poisson(1) probabilities P(n <= k), k = 0..11; beyond 11
+// (probability 1e-9) the count is capped
+struct PoissonCdf {
+  double cdf[12];
+};
+
+constexpr PoissonCdf MakePoissonCdf()
+{
+  PoissonCdf t{};
+  double p = 0.36787944117144233, sum = 0; // e^-1 / k!
+  for (int k = 0; k < 12; k++) {
+    sum += p;
+    t.cdf[k] = sum;
+    p /= k + 1;
+  }
+  return t;
+}
+
+constexpr PoissonCdf kPoissonCdf = MakePoissonCdf();
+
+// Poisson(1) weights of replicas [first, last) of entry into out[first..last)
+inline void PoissonReplicaWeights(Long64_t entry, int first, int last, double* out,
+                                  uint64_t seed = kBootstrapSeed)
+{
+  const uint64_t base = BootstrapMix(seed + BootstrapMix((uint64_t)entry));
+  for (int k = first; k < last; k++) {
+    const double u = (BootstrapMix(base + (uint64_t)k * 0x9E3779B97F4A7C15ULL) >> 11) * 0x1.0p-53;
+    int n = 0;
+    for (int j = 0; j < 12; j++) n += u >= kPoissonCdf.cdf[j];
+    out[k] = n;
+  }
+}
+
+// Empty replica histogram for nominal (uniform or variable x binning)
+inline TH2D* MakeReplicaHist(const TH1* nominal, int nreplicas)
+{
+  const TAxis* ax = nominal->GetXaxis();
+  const TString name = TString::Format("%s_replicas", nominal->GetName());
+  const TString title = TString::Format("%s, bootstrap replicas;%s;replica", nominal->GetTitle(), ax->GetTitle());
+  TH2D* h = ax->GetXbins()->GetSize()
+    ? new TH2D(name, title, ax->GetNbins(), ax->GetXbins()->GetArray(), nreplicas, -0.5, nreplicas - 0.5)
+    : new TH2D(name, title, ax->GetNbins(), ax->GetXmin(), ax->GetXmax(), nreplicas, -0.5, nreplicas - 0.5);
+  h->Sumw2();
+  return h;
+}
+
+// Adds w * poisson[k] to bin x of every replica k; the bin is looked up once.
+// Statistics such as the mean are not updated (ResetStats after the loop).
+inline void FillReplicas(TH2D* h, double x, double w, const double* poisson)
+{
+  const int nx = h->GetNbinsX(), n = h->GetNbinsY();
+  const int bx = h->GetXaxis()->FindFixBin(x);
+  double* sum = h->GetArray() + bx + (nx + 2);
+  double* sum2 = h->GetSumw2()->GetArray() + bx + (nx + 2);
+  for (int k = 0; k < n; k++) {
+    const double wk = w * poisson[k];
+    sum[(size_t)k * (nx + 2)] += wk;
+    sum2[(size_t)k * (nx + 2)] += wk * wk;
+  }
+}
+
+// Sample variance of every x bin over the replicas, with the x binning of
+// the replicas
+inline TH1D* BootstrapVariance(const TH2* replicas, const char* name)
+{
+  const int nx = replicas->GetNbinsX(), n = replicas->GetNbinsY();
+  TH1D* var = replicas->ProjectionX(name, 1, 1);
+  var->Reset();
+  var->SetTitle(Form("%s, bootstrap variance", replicas->GetTitle()));
+  for (int b = 1; b <= nx; b++) {
+    double sum = 0, sum2 = 0;
+    for (int k = 1; k <= n; k++) {
+      const double c = replicas->GetBinContent(b, k);
+      sum += c;
+      sum2 += c * c;
+    }
+    const double mean = sum / n;
+    var->SetBinContent(b, n > 1 ? (sum2 - n * mean * mean) / (n - 1) : 0);
+  }
+  return var;
+}
+
+// Sample covariance between all pairs of x bins; the sum of all its bins
+// is the variance of the histogram integral
+inline TH2D* BootstrapCovariance(const TH2* replicas, const char* name)
+{
+  const int nx = replicas->GetNbinsX(), n = replicas->GetNbinsY();
+  std::vector<double> mean(nx, 0), dev((size_t)nx * n);
+  for (int b = 0; b < nx; b++) {
+    for (int k = 0; k < n; k++) mean[b] += replicas->GetBinContent(b + 1, k + 1);
+    mean[b] /= n;
+    for (int k = 0; k < n; k++) dev[(size_t)b * n + k] = replicas->GetBinContent(b + 1, k + 1) - mean[b];
+  }
+  const TAxis* ax = replicas->GetXaxis();
+  const char* title = Form("%s, bootstrap covariance;%s;%s", replicas->GetTitle(), ax->GetTitle(), ax->GetTitle());
+  TH2D* cov = ax->GetXbins()->GetSize()
+    ? new TH2D(name, title, nx, ax->GetXbins()->GetArray(), nx, ax->GetXbins()->GetArray())
+    : new TH2D(name, title, nx, ax->GetXmin(), ax->GetXmax(), nx, ax->GetXmin(), ax->GetXmax());
+  for (int a = 0; a < nx; a++) {
+    for (int b = 0; b <= a; b++) {
+      double c = 0;
+      for (int k = 0; k < n; k++) c += dev[(size_t)a * n + k] * dev[(size_t)b * n + k];
+      c = n > 1 ? c / (n - 1) : 0;
+      cov->SetBinContent(a + 1, b + 1, c);
+      cov->SetBinContent(b + 1, a + 1, c);
+    }
+  }
+  return cov;
+}
+
+// Replaces the errors of nominal by the bootstrap standard deviations
+inline void SetBootstrapErrors(TH1* nominal, const TH1* variance)
+{
+  for (int b = 1; b <= nominal->GetNbinsX(); b++)
+    nominal->SetBinError(b, std::sqrt(std::max(variance->GetBinContent(b), 0.0)));
+}
+
+#endif
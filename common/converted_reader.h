@@ -0,0 +1,547 @@
+//// Reader for the files written by read_genie_convert_root.cc
+////
+//// Two particle layouts are understood:
+////  - vector layout (default): one std::vector branch per particle variable
+////  - flat layout ("flat" option): a per-event count np and variable-length
+////    C arrays status[np], pdg[np], energy[np], px[np], py[np], pz[np],
+////    optionally stored as float ("float" option).
+//// Files may hold separate Event and Particles trees, a single merged
+//// "Events" tree ("merged" option), or the RNTuple format ("rntuple"
+//// option): one "Events" RNTuple with the event fields and the particles as
+//// a nested "particles" collection.
+//// The reader binds to whatever the file contains, and the analysis code
+//// accesses particles through Pdg(j), Energy(j), ... in all cases. It
+//// reads one entry at a time: for the flat layout ROOT unpacks the entry
+//// from its basket into fixed kMaxParticles buffers, so no per-event
+//// allocation happens, and RNTuple collections are copied into the same
+//// buffers from their column views. There is no zero-copy access to whole
+//// baskets: ROOT's bulk read API does not cover variable-length arrays.
+//// Events with more than kMaxParticles particles were truncated by the
+//// converter; their number is GetTruncatedEntries.
+//// GetGeneratedEntries is the number of GHEP events the file was converted
+//// from, read from its ConversionInfo record; after a skim it is larger
+//// than GetEntries.
+#ifndef MC_TUTORIAL_CONVERTED_READER_H
+#define MC_TUTORIAL_CONVERTED_READER_H
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TFriendElement.h>
+#include <TLeaf.h>
+#include <TNamed.h>
+#include <TString.h>
+#include <TROOT.h>
+#include <TKey.h>
+#include <ROOT/RNTuple.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Maximum number of GHEP particles per event in the flat layout
+const int kMaxParticles = 1000;
+
+// Fixed-capacity particle arrays used by the flat layout, both when writing
+// and when reading. Momentum and energy have arrays in both precisions; only
+// the one matching the file is bound to the branches and filled.
+struct FlatParticles {
+  int np = 0;
+  int status[kMaxParticles];
+  int pdg[kMaxParticles];
+  double energy[kMaxParticles], px[kMaxParticles], py[kMaxParticles], pz[kMaxParticles];
+  float energyF[kMaxParticles], pxF[kMaxParticles], pyF[kMaxParticles], pzF[kMaxParticles];
+};
+
+// Name of the merged tree or RNTuple written by the "merged" and "rntuple" options
+const char* const kEventsName = "Events";
+
+// TTreeCache size used by ConvertedReader
+const Long64_t kCacheSize = 64*1024*1024;
+
+// Column views on the event fields of the "Events" RNTuple
+struct NtupleEventViews {
+  ROOT::Experimental::RNTupleView<int> nupdg;
+  ROOT::Experimental::RNTupleView<double> nuE, nuPx, nuPy, nuPz, xsection;
+  ROOT::Experimental::RNTupleView<bool> IsQE, IsRES, IsDIS, IsCoh, IsMEC, IsCC, IsNC;
+
+  explicit NtupleEventViews(ROOT::Experimental::RNTupleReader& r)
+    : nupdg(r.GetView<int>("nupdg")), nuE(r.GetView<double>("nuE")),
+      nuPx(r.GetView<double>("nuPx")), nuPy(r.GetView<double>("nuPy")),
+      nuPz(r.GetView<double>("nuPz")), xsection(r.GetView<double>("xsection")),
+      IsQE(r.GetView<bool>("IsQE")), IsRES(r.GetView<bool>("IsRES")),
+      IsDIS(r.GetView<bool>("IsDIS")), IsCoh(r.GetView<bool>("IsCoh")),
+      IsMEC(r.GetView<bool>("IsMEC")), IsCC(r.GetView<bool>("IsCC")),
+      IsNC(r.GetView<bool>("IsNC")) {}
+};
+
+// Column views on the derived kinematics fields (files converted since they
+// were added)
+struct NtupleKinematicsViews {
+  ROOT::Experimental::RNTupleView<int> lepIndex, lepPdg;
+  ROOT::Experimental::RNTupleView<double> lepE, q3, omega, Q2, W, x, y, Ehad;
+
+  explicit NtupleKinematicsViews(ROOT::Experimental::RNTupleReader& r)
+    : lepIndex(r.GetView<int>("lepIndex")), lepPdg(r.GetView<int>("lepPdg")),
+      lepE(r.GetView<double>("lepE")), q3(r.GetView<double>("q3")),
+      omega(r.GetView<double>("omega")), Q2(r.GetView<double>("Q2")),
+      W(r.GetView<double>("W")), x(r.GetView<double>("x")),
+      y(r.GetView<double>("y")), Ehad(r.GetView<double>("Ehad")) {}
+};
+
+// Column views on GENIE's selected kinematics (files converted since they
+// were split from the lepton-derived ones)
+struct NtupleSelectedViews {
+  ROOT::Experimental::RNTupleView<double> Q2sel, Wsel, xsel, ysel;
+
+  explicit NtupleSelectedViews(ROOT::Experimental::RNTupleReader& r)
+    : Q2sel(r.GetView<double>("Q2sel")), Wsel(r.GetView<double>("Wsel")),
+      xsel(r.GetView<double>("xsel")), ysel(r.GetView<double>("ysel")) {}
+};
+
+// Column views on the nested "particles" collection; T is the stored
+// precision of energy and momenta
+template <typename T>
+struct NtupleParticleViews {
+  ROOT::Experimental::RNTupleViewCollection particles;
+  ROOT::Experimental::RNTupleView<int> status, pdg;
+  ROOT::Experimental::RNTupleView<T> energy, px, py, pz;
+
+  explicit NtupleParticleViews(ROOT::Experimental::RNTupleReader& r)
+    : particles(r.GetViewCollection("particles")),
+      status(particles.GetView<int>("status")), pdg(particles.GetView<int>("pdg")),
+      energy(particles.GetView<T>("energy")), px(particles.GetView<T>("px")),
+      py(particles.GetView<T>("py")), pz(particles.GetView<T>("pz")) {}
+
+  // Copy the particles of entry i into the given arrays, return their number
+  int Load(Long64_t i, int* st, int* id, T* e, T* x, T* y, T* z)
+  {
+    int n = 0;
+    for (auto k : particles.GetCollectionRange(i)) {
+      if (n == kMaxParticles) break;
+      st[n] = status(k);
+      id[n] = pdg(k);
+      e[n] = energy(k);
+      x[n] = px(k);
+      y[n] = py(k);
+      z[n] = pz(k);
+      n++;
+    }
+    return n;
+  }
+};
+
+class ConvertedReader {
+public:
+  // What to read besides the event-level variables
+  enum ParticleMode {
+    kNoParticles = 0,
+    kParticles = 1,
+    kParticlesIfNoKinematics = 2 // particles only for files without derived kinematics
+  };
+
+  explicit ConvertedReader(const char* filename, int mode = kParticles)
+  {
+    fFile = TFile::Open(filename);
+    if (!fFile || fFile->IsZombie()) {
+      std::cerr << "Error: cannot open " << filename << std::endl;
+      return;
+    }
+    ReadConversionInfo();
+    gROOT->cd(); // histograms booked by the caller must outlive the file
+
+    TKey* key = fFile->GetKey(kEventsName);
+    if (key && TString(key->GetClassName()).Contains("RNTuple")) {
+      OpenNtuple(filename, mode);
+      return;
+    }
+
+    // Merged layout: events and particles in one tree
+    if (key && TString(key->GetClassName()) == "TTree") {
+      fEvent = (TTree*)fFile->Get(kEventsName);
+      BindEvent();
+      if (WantParticles(mode)) {
+        fParticles = fEvent;
+        BindParticles();
+      } else {
+        ReadEventBranchesOnly();
+      }
+      SetupCache();
+      return;
+    }
+
+    fEvent = (TTree*)fFile->Get("Event");
+    if (!fEvent) {
+      std::cerr << "Error: cannot find Event tree in " << filename << std::endl;
+      return;
+    }
+    BindEvent();
+
+    if (WantParticles(mode)) {
+      fParticles = (TTree*)fFile->Get("Particles");
+      if (!fParticles) {
+        std::cerr << "Error: cannot find Particles tree in " << filename << std::endl;
+        fEvent = nullptr;
+        return;
+      }
+      // Both trees are filled in the same entry order, so reading the
+      // particles as a friend costs a single GetEntry per event (each tree
+      // still reads through its own cache, see SetupCache)
+      fEvent->AddFriend(fParticles);
+      BindParticles();
+    }
+    SetupCache();
+  }
+
+  ~ConvertedReader()
+  {
+    if (fFile) fFile->Close();
+    delete fFile;
+    delete fFlat;
+  }
+
+  ConvertedReader(const ConvertedReader&) = delete;
+  ConvertedReader& operator=(const ConvertedReader&) = delete;
+
+  bool IsOpen() const { return fEvent != nullptr || fNtuple != nullptr; }
+  bool HasParticles() const { return fParticles != nullptr || fFlat != nullptr; }
+  bool HasKinematics() const { return fHasKinematics; }
+  bool IsNtuple() const { return fNtuple != nullptr; }
+  bool IsFlat() const { return fFlat != nullptr && !fNtuple; }
+  bool IsFloat() const { return fFloat; }
+  Long64_t GetEntries() const
+  {
+    if (fNtuple) return fNtuple->GetNEntries();
+    return fEvent ? fEvent->GetEntries() : 0;
+  }
+  // GHEP events the file was converted from, before any skim; files
+  // without a ConversionInfo record (converted before it existed, or
+  // incomplete) are assumed unskimmed
+  Long64_t GetGeneratedEntries() const { return fGenerated >= 0 ? fGenerated : GetEntries(); }
+  bool IsSkimmed() const { return GetGeneratedEntries() != GetEntries(); }
+  // Entries whose particle list the converter cut to kMaxParticles, 0 if
+  // not recorded
+  Long64_t GetTruncatedEntries() const { return fTruncated; }
+  TFile* GetFile() const { return fFile; }
+  TTree* GetEventTree() const { return fEvent; }
+  TTree* GetParticleTree() const { return fParticles; }
+  // Entry last read with GetEntry, -1 before the first
+  Long64_t CurrentEntry() const { return fEntry; }
+
+  void GetEntry(Long64_t i)
+  {
+    fEntry = i;
+    if (fNtuple) {
+      GetNtupleEntry(i);
+      return;
+    }
+    fEvent->GetEntry(i); // also reads the Particles friend
+    if (!fParticles) return;
+    if (!fFlat) {
+      fNp = (int)fPdgV->size();
+      fStatusP = fStatusV->data();
+      fPdgP = fPdgV->data();
+      fEnergyP = fEnergyV->data();
+      fPxP = fPxV->data();
+      fPyP = fPyV->data();
+      fPzP = fPzV->data();
+    } else {
+      fNp = fFlat->np;
+    }
+  }
+
+  // Reads the double branch column of tree treeName in file as a friend of
+  // the event tree, so every GetEntry also reads it, through its own cache.
+  // Returns the index k for FriendColumn(k), or -1 for RNTuple files and
+  // for trees that are missing or do not have one entry per event.
+  int AddFriendColumn(const char* file, const char* treeName, const char* column)
+  {
+    if (!fEvent || fNtuple) return -1;
+    TFriendElement* fe = fEvent->AddFriend(treeName, file);
+    TTree* t = fe ? fe->GetTree() : nullptr;
+    if (!t || t->GetEntries() != fEvent->GetEntries() || !t->GetBranch(column)) {
+      if (fe) {
+        fEvent->GetListOfFriends()->Remove(fe);
+        delete fe;
+      }
+      return -1;
+    }
+    fFriendValues.push_back(0);
+    t->SetBranchAddress(column, &fFriendValues.back());
+    t->SetCacheSize(kCacheSize);
+    t->AddBranchToCache("*", kTRUE);
+    gROOT->cd(); // AddFriend opened the file
+    return (int)fFriendValues.size() - 1;
+  }
+  double FriendColumn(int k) const { return fFriendValues[k]; }
+  int NFriendColumns() const { return (int)fFriendValues.size(); }
+
+  // Particle access for the current entry
+  int NParticles() const { return fNp; }
+  int Status(int j) const { return fStatusP[j]; }
+  int Pdg(int j) const { return fPdgP[j]; }
+  double Energy(int j) const { return fFloat ? fFlat->energyF[j] : fEnergyP[j]; }
+  double Px(int j) const { return fFloat ? fFlat->pxF[j] : fPxP[j]; }
+  double Py(int j) const { return fFloat ? fFlat->pyF[j] : fPyP[j]; }
+  double Pz(int j) const { return fFloat ? fFlat->pzF[j] : fPzP[j]; }
+
+  // Event-level variables of the current entry
+  int nupdg = 0;
+  double nuE = 0, nuPx = 0, nuPy = 0, nuPz = 0, xsection = 1.0;
+  bool IsQE = false, IsRES = false, IsDIS = false, IsCoh = false, IsMEC = false;
+  bool IsCC = false, IsNC = false;
+
+  // Derived kinematics written by the converter (HasKinematics()); lepIndex
+  // is the primary lepton's position in the particle list, -1 if none
+  int lepIndex = -1, lepPdg = 0;
+  double lepE = -1, q3 = 0, omega = 0, Q2 = 0, W = 0, x = 0, y = 0, Ehad = 0;
+  // GENIE's selected kinematics (hit-nucleon based), -1 where the generator
+  // did not set them or the file does not store them
+  double Q2sel = -1, Wsel = -1, xsel = -1, ysel = -1;
+
+private:
+  // The "entries=" and "truncated=" fields of the ConversionInfo title,
+  // written both for single files and for merged campaigns
+  void ReadConversionInfo()
+  {
+    TNamed* info = dynamic_cast<TNamed*>(fFile->Get("ConversionInfo"));
+    if (!info) return;
+    TString title = info->GetTitle();
+    Ssiz_t pos = title.Index(";entries=");
+    if (pos != kNPOS) fGenerated = std::atoll(title.Data() + pos + 9);
+    pos = title.Index(";truncated=");
+    if (pos != kNPOS) fTruncated = std::atoll(title.Data() + pos + 11);
+  }
+
+  // TTreeCaches for everything read per event. A cache only serves the
+  // branches of its own tree, so the split layout needs a second one for
+  // the Particles friend; a merged tree gets by with one. Without particles
+  // only the enabled branches are cached, so a merged tree does not
+  // prefetch the particles.
+  void SetupCache()
+  {
+    fEvent->SetCacheSize(kCacheSize);
+    if (fParticles) {
+      fEvent->AddBranchToCache("*", kTRUE);
+      if (fParticles != fEvent) {
+        fParticles->SetCacheSize(kCacheSize);
+        fParticles->AddBranchToCache("*", kTRUE);
+      }
+      return;
+    }
+    TIter next(fEvent->GetListOfBranches());
+    while (TBranch* b = (TBranch*)next())
+      if (fEvent->GetBranchStatus(b->GetName())) fEvent->AddBranchToCache(b, kTRUE);
+  }
+
+  // Merged tree without particles: switch off everything but the event
+  // (and kinematics) branches, so GetEntry does not read the particles
+  void ReadEventBranchesOnly()
+  {
+    static const char* const event[] = {"nupdg", "nuE", "nuPx", "nuPy", "nuPz", "xsection", "IsQE", "IsRES",
+                                        "IsDIS", "IsCoh", "IsMEC", "IsCC", "IsNC"};
+    static const char* const kinematics[] = {"lepIndex", "lepPdg", "lepE", "q3", "omega", "Q2", "W", "x", "y",
+                                             "Ehad"};
+    fEvent->SetBranchStatus("*", 0);
+    for (const char* name : event) fEvent->SetBranchStatus(name, 1);
+    if (fHasKinematics)
+      for (const char* name : kinematics) fEvent->SetBranchStatus(name, 1);
+    if (fHasSelected)
+      for (const char* name : {"Q2sel", "Wsel", "xsel", "ysel"}) fEvent->SetBranchStatus(name, 1);
+  }
+
+  bool WantParticles(int mode) const
+  {
+    return mode == kParticles || (mode == kParticlesIfNoKinematics && !fHasKinematics);
+  }
+
+  void OpenNtuple(const char* filename, int mode)
+  {
+    fNtuple = ROOT::Experimental::RNTupleReader::Open(kEventsName, filename);
+    fEventViews = std::make_unique<NtupleEventViews>(*fNtuple);
+    try {
+      fKinematicsViews = std::make_unique<NtupleKinematicsViews>(*fNtuple);
+      fHasKinematics = true;
+    } catch (const ROOT::Experimental::RException&) {
+      // converted before the derived kinematics existed
+    }
+    try {
+      fSelectedViews = std::make_unique<NtupleSelectedViews>(*fNtuple);
+      fHasSelected = true;
+    } catch (const ROOT::Experimental::RException&) {
+      // converted before GENIE's selected kinematics had their own fields
+    }
+    if (!WantParticles(mode)) return;
+
+    fFlat = new FlatParticles();
+    try {
+      fDoubleViews = std::make_unique<NtupleParticleViews<double>>(*fNtuple);
+    } catch (const ROOT::Experimental::RException&) {
+      // energy and momenta were written as float
+      fFloatViews = std::make_unique<NtupleParticleViews<float>>(*fNtuple);
+      fFloat = true;
+    }
+    fStatusP = fFlat->status;
+    fPdgP = fFlat->pdg;
+    fEnergyP = fFlat->energy;
+    fPxP = fFlat->px;
+    fPyP = fFlat->py;
+    fPzP = fFlat->pz;
+  }
+
+  void GetNtupleEntry(Long64_t i)
+  {
+    NtupleEventViews& v = *fEventViews;
+    nupdg = v.nupdg(i);
+    nuE = v.nuE(i);
+    nuPx = v.nuPx(i);
+    nuPy = v.nuPy(i);
+    nuPz = v.nuPz(i);
+    xsection = v.xsection(i);
+    IsQE = v.IsQE(i);
+    IsRES = v.IsRES(i);
+    IsDIS = v.IsDIS(i);
+    IsCoh = v.IsCoh(i);
+    IsMEC = v.IsMEC(i);
+    IsCC = v.IsCC(i);
+    IsNC = v.IsNC(i);
+
+    if (fKinematicsViews) {
+      NtupleKinematicsViews& k = *fKinematicsViews;
+      lepIndex = k.lepIndex(i);
+      lepPdg = k.lepPdg(i);
+      lepE = k.lepE(i);
+      q3 = k.q3(i);
+      omega = k.omega(i);
+      Q2 = k.Q2(i);
+      W = k.W(i);
+      x = k.x(i);
+      y = k.y(i);
+      Ehad = k.Ehad(i);
+    }
+    if (fSelectedViews) {
+      NtupleSelectedViews& s = *fSelectedViews;
+      Q2sel = s.Q2sel(i);
+      Wsel = s.Wsel(i);
+      xsel = s.xsel(i);
+      ysel = s.ysel(i);
+    }
+
+    if (fDoubleViews)
+      fNp = fDoubleViews->Load(i, fFlat->status, fFlat->pdg, fFlat->energy,
+                               fFlat->px, fFlat->py, fFlat->pz);
+    else if (fFloatViews)
+      fNp = fFloatViews->Load(i, fFlat->status, fFlat->pdg, fFlat->energyF,
+                              fFlat->pxF, fFlat->pyF, fFlat->pzF);
+  }
+
+  void BindEvent()
+  {
+    fEvent->SetBranchAddress("nupdg", &nupdg);
+    fEvent->SetBranchAddress("nuE", &nuE);
+    fEvent->SetBranchAddress("nuPx", &nuPx);
+    fEvent->SetBranchAddress("nuPy", &nuPy);
+    fEvent->SetBranchAddress("nuPz", &nuPz);
+    fEvent->SetBranchAddress("xsection", &xsection);
+    fEvent->SetBranchAddress("IsQE", &IsQE);
+    fEvent->SetBranchAddress("IsRES", &IsRES);
+    fEvent->SetBranchAddress("IsDIS", &IsDIS);
+    fEvent->SetBranchAddress("IsCoh", &IsCoh);
+    fEvent->SetBranchAddress("IsMEC", &IsMEC);
+    fEvent->SetBranchAddress("IsCC", &IsCC);
+    fEvent->SetBranchAddress("IsNC", &IsNC);
+
+    fHasKinematics = fEvent->GetBranch("Q2") != nullptr;
+    if (!fHasKinematics) return;
+    fEvent->SetBranchAddress("lepIndex", &lepIndex);
+    fEvent->SetBranchAddress("lepPdg", &lepPdg);
+    fEvent->SetBranchAddress("lepE", &lepE);
+    fEvent->SetBranchAddress("q3", &q3);
+    fEvent->SetBranchAddress("omega", &omega);
+    fEvent->SetBranchAddress("Q2", &Q2);
+    fEvent->SetBranchAddress("W", &W);
+    fEvent->SetBranchAddress("x", &x);
+    fEvent->SetBranchAddress("y", &y);
+    fEvent->SetBranchAddress("Ehad", &Ehad);
+
+    fHasSelected = fEvent->GetBranch("Q2sel") != nullptr;
+    if (!fHasSelected) return;
+    fEvent->SetBranchAddress("Q2sel", &Q2sel);
+    fEvent->SetBranchAddress("Wsel", &Wsel);
+    fEvent->SetBranchAddress("xsel", &xsel);
+    fEvent->SetBranchAddress("ysel", &ysel);
+  }
+
+  void BindParticles()
+  {
+    if (!fParticles->GetBranch("np")) {
+      fParticles->SetBranchAddress("status", &fStatusV);
+      fParticles->SetBranchAddress("pdg", &fPdgV);
+      fParticles->SetBranchAddress("energy", &fEnergyV);
+      fParticles->SetBranchAddress("px", &fPxV);
+      fParticles->SetBranchAddress("py", &fPyV);
+      fParticles->SetBranchAddress("pz", &fPzV);
+      return;
+    }
+
+    fFlat = new FlatParticles();
+    TLeaf* leaf = fParticles->GetLeaf("energy");
+    fFloat = leaf && TString(leaf->GetTypeName()) == "Float_t";
+    fParticles->SetBranchAddress("np", &fFlat->np);
+    fParticles->SetBranchAddress("status", fFlat->status);
+    fParticles->SetBranchAddress("pdg", fFlat->pdg);
+    if (fFloat) {
+      fParticles->SetBranchAddress("energy", fFlat->energyF);
+      fParticles->SetBranchAddress("px", fFlat->pxF);
+      fParticles->SetBranchAddress("py", fFlat->pyF);
+      fParticles->SetBranchAddress("pz", fFlat->pzF);
+    } else {
+      fParticles->SetBranchAddress("energy", fFlat->energy);
+      fParticles->SetBranchAddress("px", fFlat->px);
+      fParticles->SetBranchAddress("py", fFlat->py);
+      fParticles->SetBranchAddress("pz", fFlat->pz);
+    }
+    fStatusP = fFlat->status;
+    fPdgP = fFlat->pdg;
+    fEnergyP = fFlat->energy;
+    fPxP = fFlat->px;
+    fPyP = fFlat->py;
+    fPzP = fFlat->pz;
+  }
+
+  TFile* fFile = nullptr;
+  Long64_t fGenerated = -1; // from ConversionInfo, -1 if not recorded
+  Long64_t fTruncated = 0;
+  TTree* fEvent = nullptr;
+  Long64_t fEntry = -1;
+  TTree* fParticles = nullptr;
+
+  // vector layout
+  std::vector<int> *fStatusV = nullptr, *fPdgV = nullptr;
+  std::vector<double> *fEnergyV = nullptr, *fPxV = nullptr, *fPyV = nullptr, *fPzV = nullptr;
+
+  // flat layout, also the particle buffer of the RNTuple format
+  FlatParticles* fFlat = nullptr;
+
+  // RNTuple format
+  std::unique_ptr<ROOT::Experimental::RNTupleReader> fNtuple;
+  std::unique_ptr<NtupleEventViews> fEventViews;
+  std::unique_ptr<NtupleKinematicsViews> fKinematicsViews;
+  std::unique_ptr<NtupleSelectedViews> fSelectedViews;
+  std::unique_ptr<NtupleParticleViews<double>> fDoubleViews;
+  std::unique_ptr<NtupleParticleViews<float>> fFloatViews;
+  bool fFloat = false;
+  bool fHasKinematics = false;
+  bool fHasSelected = false;
+
+  // friend columns; a deque keeps the bound addresses stable
+  std::deque<double> fFriendValues;
+
+  // views on the current entry, whichever layout backs them
+  int fNp = 0;
+  const int *fStatusP = nullptr, *fPdgP = nullptr;
+  const double *fEnergyP = nullptr, *fPxP = nullptr, *fPyP = nullptr, *fPzP = nullptr;
+};
+
+#endif
@@ -0,0 +1,182 @@
+//// Neutrino propagation through a layered (PREM-like) Earth.
+//// A neutrino arriving with zenith angle theta (cos theta < 0: from below)
+//// crosses the atmosphere and then a sequence of spherical shells of
+//// constant density and electron fraction. Its evolution matrix is the
+//// product over the path segments, S = S_n ... S_2 S_1, of the
+//// constant-density matrices of common/oscillation.h.
+////
+//// EarthOscillogram tabulates the nine probabilities on an (E, cos theta)
+//// grid. The spectral form of the Hamiltonian (eigenvalues and projectors)
+//// depends on the layer and the energy but not on the chord length, so it
+//// is computed once per (layer, energy bin); a zenith bin then only needs
+//// three phases per segment and the matrix products along its own path.
+//// Zenith bins are filled in parallel.
+#ifndef MC_TUTORIAL_EARTH_MODEL_H
+#define MC_TUTORIAL_EARTH_MODEL_H
+
+#include <ROOT/TThreadExecutor.hxx>
+#include <cmath>
+#include <vector>
+
+#include "entry_ranges.h"
+#include "oscillation.h"
+
+// Spherical shell from the previous layer's radius out to rOuter [km]
+struct EarthLayer {
+  double rOuter; // km
+  double rho;    // g/cm3
+  double Ye;     // electron fraction
+};
+
+// Production height of atmospheric neutrinos [km]
+const double kProductionHeight = 15.0;
+
+// Five-shell average of PREM: inner and outer core, lower and upper
+// mantle, crust
+inline std::vector<EarthLayer> PREMLayers()
+{
+  return {{1221.5, 13.0, 0.4656},
+          {3480.0, 11.3, 0.4656},
+          {5701.0, 5.0, 0.4957},
+          {6346.6, 3.3, 0.4957},
+          {6371.0, 2.6, 0.4957}};
+}
+
+// One straight piece of the path inside one layer; layer == layers.size()
+// stands for the atmosphere (vacuum)
+struct PathSegment {
+  int layer;
+  double length; // km
+};
+
+// Segments from the production point to a detector at the surface, in
+// the order they are crossed
+inline std::vector<PathSegment> EarthPath(const std::vector<EarthLayer>& layers, double cosz,
+                                          double hProd = kProductionHeight)
+{
+  const int nl = layers.size();
+  const double R = layers.back().rOuter;
+  const double b2 = R*R * (1 - cosz*cosz); // squared impact parameter
+  const double total = std::sqrt((R + hProd)*(R + hProd) - b2) - R*cosz;
+  std::vector<PathSegment> path;
+  if (cosz >= 0) {
+    path.push_back({nl, total});
+    return path;
+  }
+  path.push_back({nl, total + 2*R*cosz});
+
+  // Half chords inside each shell's outer radius; the deepest shell reached
+  // is crossed once, every shell above it twice
+  std::vector<double> half(nl);
+  int inner = nl - 1;
+  for (int i = nl - 1; i >= 0; i--) {
+    const double r2 = layers[i].rOuter * layers[i].rOuter;
+    if (r2 <= b2) break;
+    half[i] = std::sqrt(r2 - b2);
+    inner = i;
+  }
+  for (int i = nl - 1; i > inner; i--) path.push_back({i, half[i] - half[i - 1]});
+  path.push_back({inner, 2*half[inner]});
+  for (int i = inner + 1; i < nl; i++) path.push_back({i, half[i] - half[i - 1]});
+  return path;
+}
+
+// 2E*H of every layer plus the atmosphere, last
+inline std::vector<Matrix3> LayerHamiltonians(const Matrix3& Hvac, const std::vector<EarthLayer>& layers,
+                                              double E, bool antineutrino)
+{
+  std::vector<Matrix3> H;
+  for (const EarthLayer& l : layers) H.push_back(MatterHamiltonian(Hvac, E, l.rho, l.Ye, antineutrino));
+  H.push_back(Hvac);
+  return H;
+}
+
+// All nine probabilities P[from][to] along a path, every segment
+// diagonalised from scratch; the reference for EarthOscillogram
+inline void EarthProbabilities(const Matrix3& Hvac, const std::vector<EarthLayer>& layers,
+                               const std::vector<PathSegment>& path, double E, bool antineutrino,
+                               double P[3][3])
+{
+  const std::vector<Matrix3> H = LayerHamiltonians(Hvac, layers, E, antineutrino);
+  Matrix3 S = Matrix3::Identity();
+  for (const PathSegment& s : path) S = EvolutionMatrix(H[s.layer], s.length, E) * S;
+  for (int a = 0; a < 3; a++)
+    for (int b = 0; b < 3; b++) P[a][b] = std::norm(S.m[b][a]);
+}
+
+// Probabilities in bins of log(E) and cos(zenith), evaluated at the bin
+// centres
+class EarthOscillogram {
+public:
+  EarthOscillogram() {}
+
+  void Build(const OscParams& p, bool antineutrino, int nE, double Emin, double Emax, int nCos,
+             int nthreads = 1, const std::vector<EarthLayer>& layers = PREMLayers(),
+             double hProd = kProductionHeight)
+  {
+    fLayers = layers;
+    fHProd = hProd;
+    fAnti = antineutrino;
+    fNE = nE;
+    fNCos = nCos;
+    fLogEmin = std::log(Emin);
+    fDLogE = (std::log(Emax) - fLogEmin) / nE;
+    fHvac = VacuumHamiltonian(p, antineutrino);
+    fP.assign(9 * nE * nCos, 0);
+
+    const int nl = layers.size() + 1; // with the atmosphere
+    std::vector<SpectralHamiltonian> cache(nl * nE); // [E bin][layer]
+    ROOT::TThreadExecutor pool(std::min(ResolveThreadCount(nthreads), std::max(nE, nCos)));
+    pool.Foreach([&](unsigned int k) {
+        const std::vector<Matrix3> H = LayerHamiltonians(fHvac, fLayers, EnergyCentre(k), fAnti);
+        for (int l = 0; l < nl; l++) cache[k*nl + l] = Decompose(H[l]);
+      }, ROOT::TSeqU(nE));
+
+    pool.Foreach([&](unsigned int j) {
+        const std::vector<PathSegment> path = EarthPath(fLayers, CosCentre(j), fHProd);
+        for (int k = 0; k < fNE; k++) {
+          const double E = EnergyCentre(k);
+          Matrix3 S = cache[k*nl + path[0].layer].Evolve(path[0].length, E);
+          for (size_t s = 1; s < path.size(); s++)
+            S = cache[k*nl + path[s].layer].Evolve(path[s].length, E) * S;
+          double* out = &fP[9 * (j*fNE + k)];
+          for (int a = 0; a < 3; a++)
+            for (int b = 0; b < 3; b++) out[3*a + b] = std::norm(S.m[b][a]);
+        }
+      }, ROOT::TSeqU(nCos));
+  }
+
+  int NEnergyBins() const { return fNE; }
+  int NCosBins() const { return fNCos; }
+  bool IsAntineutrino() const { return fAnti; }
+  double EnergyEdge(int k) const { return std::exp(fLogEmin + k*fDLogE); }
+  double EnergyCentre(int k) const { return std::exp(fLogEmin + (k + 0.5)*fDLogE); }
+  double CosCentre(int j) const { return -1 + (j + 0.5) * 2.0 / fNCos; }
+
+  // Value of the (E, cos) bin; outside the energy range the path is
+  // evaluated exactly
+  double Prob(int from, int to, double E, double cosz) const
+  {
+    int j = (int)((cosz + 1) * 0.5 * fNCos);
+    j = j < 0 ? 0 : (j >= fNCos ? fNCos - 1 : j);
+    const double u = (std::log(E) - fLogEmin) / fDLogE;
+    if (E <= 0 || u < 0 || u >= fNE) {
+      if (E <= 0) return from == to ? 1.0 : 0.0;
+      double P[3][3];
+      EarthProbabilities(fHvac, fLayers, EarthPath(fLayers, cosz, fHProd), E, fAnti, P);
+      return P[from][to];
+    }
+    return fP[9 * (j*fNE + (int)u) + 3*from + to];
+  }
+
+private:
+  std::vector<EarthLayer> fLayers;
+  double fHProd = kProductionHeight;
+  bool fAnti = false;
+  int fNE = 0, fNCos = 0;
+  double fLogEmin = 0, fDLogE = 1;
+  Matrix3 fHvac;
+  std::vector<double> fP; // 9 probabilities per bin, [cos][E][from][to]
+};
+
+#endif
@@ -0,0 +1,134 @@
+//// Neutrino energy estimators for CC events, selected at compile time.
+//// Every estimator is a struct with
+////   static const char* Name();
+////   static double Estimate(const ConvertedReader& reader);  // GeV, < 0 if not applicable
+//// and EstimatorSet<A, B, ...> evaluates a fixed list of them on the
+//// current event in one call. The list is a template argument, so the
+//// loop over estimators is unrolled by the compiler: no virtual calls and
+//// no dispatch on names inside the event loop.
+////
+//// Particle masses come from common/pdg_table.h.
+#ifndef MC_TUTORIAL_ENERGY_ESTIMATORS_H
+#define MC_TUTORIAL_ENERGY_ESTIMATORS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+
+#include "converted_reader.h"
+#include "kinematics.h"
+#include "pdg_table.h"
+
+// Nuclear binding energy assumed by the QE and proton-tagged formulas [GeV]
+const double kBindingEnergy = 0.027;
+
+// First final-state (status 1) charged lepton, -1 if none
+inline int FindChargedLepton(const ConvertedReader& r)
+{
+  for (int j = 0; j < r.NParticles(); j++) {
+    const int a = std::abs(r.Pdg(j));
+    if (r.Status(j) == 1 && (a == 11 || a == 13 || a == 15)) return j;
+  }
+  return -1;
+}
+
+// First final-state particle with |pdg| == a, -1 if none
+inline int FindFinalState(const ConvertedReader& r, int a)
+{
+  for (int j = 0; j < r.NParticles(); j++)
+    if (r.Status(j) == 1 && std::abs(r.Pdg(j)) == a) return j;
+  return -1;
+}
+
+// Sum of kinetic energies of final-state muons, charged and neutral pions,
+// protons and neutrons
+struct CalorimetricEstimator {
+  static const char* Name() { return "calorimetric"; }
+  static double Estimate(const ConvertedReader& r)
+  {
+    double E = 0;
+    for (int j = 0; j < r.NParticles(); j++) {
+      if (r.Status(j) != 1) continue;
+      const int a = std::abs(r.Pdg(j));
+      if (a != 13 && a != 211 && a != 111 && a != 2212 && a != 2112) continue;
+      const double T = r.Energy(j) - PdgMass(a);
+      if (T > 0) E += T;
+    }
+    return E;
+  }
+};
+
+// Two-body CCQE formula from the final-state muon alone (numu CC, events
+// without a muon get none), neutron target bound by kBindingEnergy
+struct CCQEEstimator {
+  static constexpr int kLeptonPdg = 13;
+  static const char* Name() { return "CCQE"; }
+  static double Estimate(const ConvertedReader& r)
+  {
+    const int j = FindFinalState(r, kLeptonPdg);
+    if (j < 0) return -1;
+    const double p = std::sqrt(r.Px(j)*r.Px(j) + r.Py(j)*r.Py(j) + r.Pz(j)*r.Pz(j));
+    if (p <= 0) return -1;
+    return FromLepton(r.Energy(j), p, r.Pz(j) / p, PdgMass(r.Pdg(j)));
+  }
+  // The formula itself, for lepton energy El, momentum p, cos(theta) to the
+  // beam and mass ml; the nuclear constants can be varied
+  static double FromLepton(double El, double p, double costh, double ml, double Eb = kBindingEnergy,
+                           double Mn = PdgMass(2112), double Mp = PdgMass(2212))
+  {
+    return (2*(Mn - Eb)*El - (Eb*Eb - 2*Mn*Eb + ml*ml + (Mn*Mn - Mp*Mp))) /
+           (2*((Mn - Eb) - El + p*costh));
+  }
+};
+
+// Charged lepton energy plus the visible hadronic energy (kinetic energy of
+// protons, total energy of mesons and photons, neutrons unseen), the same
+// Ehad the converter stores
+struct HadronicPlusLeptonEstimator {
+  static const char* Name() { return "hadronic + lepton"; }
+  static double Estimate(const ConvertedReader& r)
+  {
+    const int l = FindChargedLepton(r);
+    if (l < 0) return -1;
+    double E = r.Energy(l);
+    for (int j = 0; j < r.NParticles(); j++)
+      if (r.Status(j) == 1 && j != l) E += VisibleHadronicEnergy(r.Pdg(j), r.Energy(j), r.Px(j), r.Py(j), r.Pz(j));
+    return E;
+  }
+};
+
+// Charged lepton plus the leading proton's kinetic energy and the binding
+// energy; only for events with a final-state proton
+struct ProtonTaggedEstimator {
+  static const char* Name() { return "proton-tagged"; }
+  static double Estimate(const ConvertedReader& r)
+  {
+    const int l = FindChargedLepton(r);
+    if (l < 0) return -1;
+    double Tp = -1;
+    for (int j = 0; j < r.NParticles(); j++)
+      if (r.Status(j) == 1 && r.Pdg(j) == 2212) Tp = std::fmax(Tp, r.Energy(j) - PdgMass(2212));
+    if (Tp < 0) return -1;
+    return r.Energy(l) + Tp + kBindingEnergy;
+  }
+};
+
+template <class... Estimators>
+struct EstimatorSet {
+  static constexpr size_t N = sizeof...(Estimators);
+
+  // out[k] = k-th estimator on the current event
+  static void Evaluate(const ConvertedReader& r, double* out)
+  {
+    size_t k = 0;
+    ((out[k++] = Estimators::Estimate(r)), ...);
+  }
+
+  static const char* Name(size_t k)
+  {
+    const char* names[] = {Estimators::Name()...};
+    return names[k];
+  }
+};
+
+#endif
@@ -0,0 +1,43 @@
+//// Helpers to split a tree's entry range across worker threads.
+//// Ranges are contiguous and ordered, so concatenating the per-worker
+//// results in range order reproduces the serial entry order.
+#ifndef MC_TUTORIAL_ENTRY_RANGES_H
+#define MC_TUTORIAL_ENTRY_RANGES_H
+
+#include <RtypesCore.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+struct EntryRange {
+  Long64_t begin; // first entry (inclusive)
+  Long64_t end;   // last entry (exclusive)
+  Long64_t Size() const { return end - begin; }
+};
+
+// nthreads <= 0 means "use all cores"
+inline int ResolveThreadCount(int nthreads)
+{
+  if (nthreads > 0) return nthreads;
+  unsigned int hw = std::thread::hardware_concurrency();
+  return hw > 0 ? (int)hw : 1;
+}
+
+// Split [0, nentries) into at most nparts ranges of (almost) equal size.
+inline std::vector<EntryRange> SplitEntries(Long64_t nentries, int nparts)
+{
+  std::vector<EntryRange> ranges;
+  if (nentries <= 0) return ranges;
+  nparts = (int)std::max<Long64_t>(1, std::min<Long64_t>(nparts, nentries));
+  Long64_t chunk = nentries / nparts;
+  Long64_t extra = nentries % nparts;
+  Long64_t begin = 0;
+  for (int k = 0; k < nparts; k++) {
+    Long64_t end = begin + chunk + (k < extra ? 1 : 0);
+    ranges.push_back({begin, end});
+    begin = end;
+  }
+  return ranges;
+}
+
+#endif
@@ -0,0 +1,591 @@
+//// Single-pass histogram filling for the analysis macros.
+//// An analysis describes one event as a Row (a plain struct), gives a
+//// compute step that fills the Row from a ConvertedReader, and books every
+//// histogram together with the expression, weight and cut that fill it:
+////
+////   struct Row { double Etrue, Ecal, w; };
+////   HistEngine<Row> engine([](ConvertedReader& r, Row& row) {
+////       if (!r.IsCC) return false;          // event not used at all
+////       row.Etrue = r.nuE; row.w = r.xsection; ...
+////       return true;
+////   });
+////   TH1D* h = engine.Book1D("h_true", "...", 50, 0, 5,
+////                           [](const Row& r) { return r.Etrue; },
+////                           [](const Row& r) { return r.w; });
+////   engine.Run("file_converted.root", ConvertedReader::kParticles, 8);
+////
+//// All histograms are filled in the same loop, so another plot costs no
+//// extra pass over the file. With several threads every thread reads its
+//// own block of entries into its own copies of the histograms, which are
+//// added back in block order after the loop. The compute step and the
+//// expressions are shared by all threads and must not modify captured
+//// state. Every thread reuses one Row for all its events, so the compute
+//// step must set every field the expressions read. SetReaderSetup gives a
+//// step that runs on every reader the engine opens, e.g. to add a friend
+//// column (ConvertedReader::AddFriendColumn) the compute step reads.
+////
+//// For files that are still growing, RunIncremental keeps the histograms
+//// and the number of entries already processed in a checkpoint file and
+//// on the next call only reads the entries appended since then. The
+//// checkpoint also records the analysis configuration: the booked
+//// histograms with their binning and whatever the macro passes to
+//// SetConfiguration (baseline, flux file, ...). A checkpoint written with
+//// a different configuration is discarded with a warning. The input is
+//// identified by its name and a checksum of the event fields of the first
+//// and the last processed entry, which appending keeps and replacing the
+//// file (even by one with more entries) changes.
+////
+//// Systematic universes (common/syst_universes.h) are booked with
+//// BookUniverses: the Row holds one value per universe in a contiguous
+//// array and the histogram is a TH2D with the variable on x and one row
+//// of bins per universe on y, so every universe's spectrum is contiguous
+//// in memory. All universes of an event are added in one loop over the
+//// array instead of one Fill call each.
+////
+//// Statistical uncertainties of any booked 1D histogram come from
+//// BookBootstrap (common/bootstrap.h): K Poisson-weighted replicas filled
+//// in the same loop, with weights keyed by entry number so the result does
+//// not depend on the number of threads.
+////
+//// Joint distributions in many variables are booked with BookSparse as a
+//// THnSparseD: only bins that are actually filled take memory. A memory
+//// cap (SetSparseMemoryCap) stops a run whose sparse histograms grow past
+//// it instead of letting the job run out of memory. With several threads
+//// the per-thread copies share the cap, and the merge checks it again
+//// while the copies are added up and freed one by one.
+#ifndef MC_TUTORIAL_HIST_ENGINE_H
+#define MC_TUTORIAL_HIST_ENGINE_H
+
+#include <TFile.h>
+#include <TH1D.h>
+#include <TH2D.h>
+#include <THnSparse.h>
+#include <TNamed.h>
+#include <TParameter.h>
+#include <TROOT.h>
+#include <TSystem.h>
+#include <ROOT/TThreadExecutor.hxx>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <vector>
+
+#include "bootstrap.h"
+#include "converted_reader.h"
+#include "entry_ranges.h"
+
+template <class Row>
+class HistEngine {
+public:
+  typedef std::function<bool(ConvertedReader&, Row&)> ComputeFn;
+  typedef std::function<double(const Row&)> ValueFn;
+  typedef std::function<bool(const Row&)> CutFn;
+  typedef std::function<const double*(const Row&)> ArrayFn;
+
+  explicit HistEngine(ComputeFn compute) : fCompute(compute) {}
+
+  // Called on every reader the engine opens, the main one and one per
+  // thread, before any entry is read
+  void SetReaderSetup(std::function<void(ConvertedReader&)> setup) { fReaderSetup = setup; }
+
+  // The histograms are created in the current directory like a plain
+  // new TH1D and are not deleted by the engine. Without a weight every
+  // entry counts 1, without a cut every accepted event is filled.
+  TH1D* Book1D(const char* name, const char* title, int nbins, double xmin, double xmax,
+               ValueFn x, ValueFn weight = nullptr, CutFn cut = nullptr)
+  {
+    TH1D* h = new TH1D(name, title, nbins, xmin, xmax);
+    fFills.push_back({h, false, x, nullptr, weight, cut});
+    return h;
+  }
+
+  TH2D* Book2D(const char* name, const char* title,
+               int nx, double xmin, double xmax, int ny, double ymin, double ymax,
+               ValueFn x, ValueFn y, ValueFn weight = nullptr, CutFn cut = nullptr)
+  {
+    TH2D* h = new TH2D(name, title, nx, xmin, xmax, ny, ymin, ymax);
+    fFills.push_back({h, true, x, y, weight, cut});
+    return h;
+  }
+
+  // Variable binning: edges holds nbins + 1 low edges
+  TH1D* Book1D(const char* name, const char* title, const std::vector<double>& edges,
+               ValueFn x, ValueFn weight = nullptr, CutFn cut = nullptr)
+  {
+    TH1D* h = new TH1D(name, title, edges.size() - 1, edges.data());
+    fFills.push_back({h, false, x, nullptr, weight, cut});
+    return h;
+  }
+
+  TH2D* Book2D(const char* name, const char* title,
+               const std::vector<double>& xedges, const std::vector<double>& yedges,
+               ValueFn x, ValueFn y, ValueFn weight = nullptr, CutFn cut = nullptr)
+  {
+    TH2D* h = new TH2D(name, title, xedges.size() - 1, xedges.data(), yedges.size() - 1, yedges.data());
+    fFills.push_back({h, true, x, y, weight, cut});
+    return h;
+  }
+
+  // nuniverses spectra with uniform binning; values returns the Row's
+  // array of nuniverses values. Universe u is y bin u + 1.
+  TH2D* BookUniverses(const char* name, const char* title, int nuniverses, int nbins, double xmin, double xmax,
+                      ArrayFn values, ValueFn weight = nullptr, CutFn cut = nullptr)
+  {
+    TH2D* h = new TH2D(name, title, nbins, xmin, xmax, nuniverses, -0.5, nuniverses - 0.5);
+    h->Sumw2();
+    fFills.push_back({h, true, nullptr, nullptr, weight, cut, values});
+    return h;
+  }
+
+  // nreplicas bootstrap replicas of a histogram booked with Book1D, filled
+  // with its expression, weight and cut; nullptr if h was not booked here
+  TH2D* BookBootstrap(const TH1D* h, int nreplicas)
+  {
+    for (size_t k = 0; k < fFills.size(); k++) {
+      const Fill& f = fFills[k];
+      if (f.hist != h || f.is2D) continue;
+      TH2D* r = MakeReplicaHist(h, nreplicas);
+      fFills.push_back({r, true, f.x, nullptr, f.weight, f.cut, nullptr, true});
+      return r;
+    }
+    std::cerr << "Error: " << h->GetName() << " is not a 1D histogram of this engine" << std::endl;
+    return nullptr;
+  }
+
+  // One axis of a sparse histogram and the value it is filled with
+  struct SparseAxis {
+    const char* name;   // used to select axes for projections
+    const char* title;
+    int nbins;
+    double xmin, xmax;
+    ValueFn value;
+  };
+
+  // Not attached to any directory and not deleted by the engine
+  THnSparseD* BookSparse(const char* name, const char* title, const std::vector<SparseAxis>& axes,
+                         ValueFn weight = nullptr, CutFn cut = nullptr)
+  {
+    const int ndim = axes.size();
+    std::vector<int> nbins(ndim);
+    std::vector<double> xmin(ndim), xmax(ndim);
+    std::vector<ValueFn> values(ndim);
+    for (int d = 0; d < ndim; d++) {
+      nbins[d] = axes[d].nbins;
+      xmin[d] = axes[d].xmin;
+      xmax[d] = axes[d].xmax;
+      values[d] = axes[d].value;
+    }
+    THnSparseD* h = new THnSparseD(name, title, ndim, nbins.data(), xmin.data(), xmax.data());
+    for (int d = 0; d < ndim; d++) {
+      h->GetAxis(d)->SetName(axes[d].name);
+      h->GetAxis(d)->SetTitle(axes[d].title);
+    }
+    fSparse.push_back({h, values, weight, cut});
+    return h;
+  }
+
+  // Settings that change what the histograms contain, stored in and
+  // compared with the checkpoint (RunIncremental)
+  void SetConfiguration(const char* config) { fConfig = config; }
+
+  // Upper limit for all sparse histograms together [MB], including what
+  // they hold before the run (e.g. from a checkpoint); what is left is
+  // split evenly between the threads. 0 means no limit
+  void SetSparseMemoryCap(double mb) { fSparseCapMB = mb; }
+
+  // Approximate memory of a sparse histogram: per filled bin the content,
+  // the compacted coordinate and the hash table entry (+ error if kept)
+  static double SparseMB(const THnSparse* h)
+  {
+    return h->GetNbins() * (h->GetCalculateErrors() ? 40.0 : 32.0) / 1e6;
+  }
+
+  size_t NHists() const { return fFills.size(); }
+  TH1* Hist(size_t k) const { return fFills[k].hist; }
+
+  // Events accepted by the compute step in the last Run
+  Long64_t GetAccepted() const { return fAccepted; }
+  // Entries of the input file seen by the last Run
+  Long64_t GetEntries() const { return fEntries; }
+  // GHEP events the input was converted from (ConvertedReader::GetGeneratedEntries)
+  Long64_t GetGeneratedEntries() const { return fGenerated; }
+
+  void Reset()
+  {
+    for (size_t k = 0; k < fFills.size(); k++) fFills[k].hist->Reset();
+    for (size_t k = 0; k < fSparse.size(); k++) fSparse[k].hist->Reset();
+  }
+
+  // Fill all booked histograms from entries [first, end) of filename;
+  // mode is passed to ConvertedReader. nthreads <= 0 uses all cores.
+  // Returns false if the file cannot be read.
+  bool Run(const char* filename, int mode = ConvertedReader::kParticles, int nthreads = 1,
+           Long64_t first = 0)
+  {
+    ConvertedReader reader(filename, mode);
+    if (!reader.IsOpen()) return false;
+    if (fReaderSetup) fReaderSetup(reader);
+
+    fAccepted = 0;
+    fEntries = reader.GetEntries();
+    fGenerated = reader.GetGeneratedEntries();
+    if (reader.GetTruncatedEntries() > 0 && reader.HasParticles())
+      std::cerr << "Warning: " << reader.GetTruncatedEntries() << " entries of " << filename
+                << " hold only their first " << kMaxParticles << " particles" << std::endl;
+    std::vector<EntryRange> ranges = SplitEntries(fEntries - first, ResolveThreadCount(nthreads));
+    for (size_t k = 0; k < ranges.size(); k++) {
+      ranges[k].begin += first;
+      ranges[k].end += first;
+    }
+    if (ranges.size() <= 1) {
+      bool capped = false;
+      if (first < fEntries) fAccepted = Loop(reader, fFills, fSparse, {first, fEntries}, fSparseCapMB, capped);
+      ResetDirectFillStats();
+      return !capped || SparseCapError(filename);
+    }
+
+    // Private histogram copies are made here, the workers only read and fill
+    ROOT::EnableThreadSafety();
+    std::vector<std::vector<Fill>> parts(ranges.size(), fFills);
+    for (size_t k = 0; k < parts.size(); k++) {
+      for (size_t j = 0; j < parts[k].size(); j++) {
+        TH1* h = (TH1*)fFills[j].hist->Clone(TString::Format("%s_t%zu", fFills[j].hist->GetName(), k));
+        h->SetDirectory(nullptr);
+        h->Reset();
+        parts[k][j].hist = h;
+      }
+    }
+    std::vector<std::vector<SparseFill>> sparseParts(ranges.size(), fSparse);
+    for (size_t k = 0; k < sparseParts.size(); k++) {
+      for (size_t j = 0; j < sparseParts[k].size(); j++) {
+        THnSparse* h = (THnSparse*)fSparse[j].hist->Clone(TString::Format("%s_t%zu", fSparse[j].hist->GetName(), k));
+        h->Reset();
+        sparseParts[k][j].hist = h;
+      }
+    }
+    const double capMB = SparseCapLeft() / ranges.size();
+    std::vector<char> capped(ranges.size(), 0);
+
+    std::vector<Long64_t> accepted(ranges.size(), -1);
+    ROOT::TThreadExecutor pool(ranges.size());
+    pool.Foreach([&](unsigned int k) {
+        ConvertedReader own(filename, mode);
+        if (own.IsOpen() && fReaderSetup) fReaderSetup(own);
+        bool full = false;
+        if (own.IsOpen()) accepted[k] = Loop(own, parts[k], sparseParts[k], ranges[k], capMB, full);
+        capped[k] = full;
+      }, ROOT::TSeqU(ranges.size()));
+
+    // Merge in block order
+    bool ok = true, anyCapped = false, mergeCapped = false;
+    for (size_t k = 0; k < parts.size(); k++) {
+      ok = ok && accepted[k] >= 0;
+      anyCapped = anyCapped || capped[k];
+      fAccepted += std::max<Long64_t>(accepted[k], 0);
+      for (size_t j = 0; j < parts[k].size(); j++) {
+        fFills[j].hist->Add(parts[k][j].hist);
+        delete parts[k][j].hist;
+      }
+      // Merged histograms and the copies not yet added are in memory
+      // together, so both count against the cap; once it is passed the
+      // remaining copies are only freed
+      for (size_t j = 0; j < sparseParts[k].size(); j++) {
+        if (!mergeCapped) fSparse[j].hist->Add(sparseParts[k][j].hist);
+        delete sparseParts[k][j].hist;
+        sparseParts[k][j].hist = nullptr;
+      }
+      if (fSparseCapMB > 0 && !mergeCapped && !fSparse.empty()) {
+        double mb = 0;
+        for (const SparseFill& f : fSparse) mb += SparseMB(f.hist);
+        for (size_t m = k + 1; m < sparseParts.size(); m++)
+          for (const SparseFill& f : sparseParts[m]) mb += SparseMB(f.hist);
+        mergeCapped = mb > fSparseCapMB;
+        anyCapped = anyCapped || mergeCapped;
+      }
+    }
+    ResetDirectFillStats();
+    if (!ok) std::cerr << "Error: a worker could not read " << filename << std::endl;
+    if (anyCapped) ok = SparseCapError(filename);
+    return ok;
+  }
+
+  // Run over the entries of filename appended since the last call with the
+  // same checkpoint, on top of the histograms saved there, then save the
+  // new state. Without a usable checkpoint (first call, other input file,
+  // file replaced or rewritten with fewer entries, histograms booked
+  // differently) the whole file is processed.
+  bool RunIncremental(const char* filename, const char* checkpoint,
+                      int mode = ConvertedReader::kParticles, int nthreads = 1)
+  {
+    Long64_t first = LoadCheckpoint(checkpoint, filename);
+    if (!Run(filename, mode, nthreads, first)) return false;
+    if (first > fEntries) {
+      std::cout << filename << " has fewer entries than checkpoint " << checkpoint
+                << ", processing it again from the start" << std::endl;
+      Reset();
+      first = 0;
+      if (!Run(filename, mode, nthreads)) return false;
+    }
+    std::cout << "Processed entries [" << first << ", " << fEntries << ") of " << filename
+              << ", " << first << " taken from " << checkpoint << std::endl;
+    return SaveCheckpoint(checkpoint, filename);
+  }
+
+private:
+  struct Fill {
+    TH1* hist;
+    bool is2D;
+    ValueFn x, y, weight;
+    CutFn cut;
+    ArrayFn universes; // set for BookUniverses
+    bool bootstrap;    // replicas of x, see BookBootstrap
+  };
+
+  struct SparseFill {
+    THnSparse* hist;
+    std::vector<ValueFn> values;
+    ValueFn weight;
+    CutFn cut;
+  };
+
+  // The SetConfiguration string followed by name and binning of every
+  // booked histogram
+  TString Configuration() const
+  {
+    TString c = fConfig;
+    auto axis = [&c](const TAxis* a) {
+      c += TString::Format(":%d[%g,%g]", a->GetNbins(), a->GetXmin(), a->GetXmax());
+      if (a->GetXbins()->GetSize()) c += "var";
+    };
+    for (const Fill& f : fFills) {
+      c += TString(";") + f.hist->GetName();
+      axis(f.hist->GetXaxis());
+      if (f.is2D) axis(f.hist->GetYaxis());
+    }
+    for (const SparseFill& f : fSparse) {
+      c += TString(";") + f.hist->GetName();
+      for (int d = 0; d < f.hist->GetNdimensions(); d++) axis(f.hist->GetAxis(d));
+    }
+    return c;
+  }
+
+  // FNV-1a hash of the event fields of entries 0 and n - 1 of filename,
+  // empty if the file has fewer than n entries
+  static TString InputChecksum(const char* filename, Long64_t n)
+  {
+    ConvertedReader r(filename, ConvertedReader::kNoParticles);
+    if (!r.IsOpen() || n <= 0 || n > r.GetEntries()) return "";
+    uint64_t h = 14695981039346656037ULL;
+    for (Long64_t i : {(Long64_t)0, n - 1}) {
+      r.GetEntry(i);
+      const double v[] = {(double)r.nupdg, r.nuE, r.nuPx, r.nuPy, r.nuPz, r.xsection};
+      const unsigned char* p = (const unsigned char*)v;
+      for (size_t k = 0; k < sizeof(v); k++) {
+        h ^= p[k];
+        h *= 1099511628211ULL;
+      }
+    }
+    return TString::Format("%016llx", (unsigned long long)h);
+  }
+
+  // Restores the histograms from checkpoint and returns the number of
+  // entries they contain, or 0 (histograms reset) if it cannot be used
+  Long64_t LoadCheckpoint(const char* checkpoint, const char* filename)
+  {
+    Reset();
+    if (gSystem->AccessPathName(checkpoint)) return 0; // no checkpoint yet
+    TFile* f = TFile::Open(checkpoint, "READ");
+    gROOT->cd();
+    if (!f || f->IsZombie()) {
+      std::cerr << "Warning: cannot read checkpoint " << checkpoint << ", starting over" << std::endl;
+      delete f;
+      return 0;
+    }
+    TNamed* input = f->Get<TNamed>("CheckpointInput");
+    TNamed* config = f->Get<TNamed>("CheckpointConfig");
+    TNamed* checksum = f->Get<TNamed>("CheckpointInputChecksum");
+    TParameter<Long64_t>* done = f->Get<TParameter<Long64_t>>("CheckpointEntries");
+    Long64_t entries = 0;
+    if (!input || !done || TString(input->GetTitle()) != filename) {
+      std::cout << "Checkpoint " << checkpoint << " belongs to another input, starting over" << std::endl;
+    } else if (!checksum || InputChecksum(filename, done->GetVal()) != checksum->GetTitle()) {
+      std::cerr << "Warning: " << filename << " was replaced since checkpoint " << checkpoint
+                << " was written, starting over" << std::endl;
+    } else if (!config || Configuration() != config->GetTitle()) {
+      std::cerr << "Warning: checkpoint " << checkpoint << " was written with another configuration ("
+                << (config ? config->GetTitle() : "none") << "), starting over" << std::endl;
+    } else {
+      entries = done->GetVal();
+      for (size_t k = 0; k < fFills.size() && entries > 0; k++) {
+        TH1* saved = f->Get<TH1>(fFills[k].hist->GetName());
+        if (!saved || saved->GetNcells() != fFills[k].hist->GetNcells()) {
+          std::cout << "Checkpoint " << checkpoint << " has no " << fFills[k].hist->GetName()
+                    << " with this binning, starting over" << std::endl;
+          entries = 0;
+          break;
+        }
+        fFills[k].hist->Add(saved);
+      }
+      for (size_t k = 0; k < fSparse.size() && entries > 0; k++) {
+        THnSparse* saved = f->Get<THnSparse>(fSparse[k].hist->GetName());
+        bool same = saved && saved->GetNdimensions() == fSparse[k].hist->GetNdimensions();
+        for (int d = 0; same && d < saved->GetNdimensions(); d++)
+          same = saved->GetAxis(d)->GetNbins() == fSparse[k].hist->GetAxis(d)->GetNbins();
+        if (!same) {
+          std::cout << "Checkpoint " << checkpoint << " has no " << fSparse[k].hist->GetName()
+                    << " with this binning, starting over" << std::endl;
+          entries = 0;
+          break;
+        }
+        fSparse[k].hist->Add(saved);
+      }
+      if (entries == 0) Reset();
+    }
+    f->Close();
+    delete f;
+    return entries;
+  }
+
+  // Written to a temporary file first, so an interrupted run leaves the
+  // previous checkpoint intact
+  bool SaveCheckpoint(const char* checkpoint, const char* filename) const
+  {
+    TString tmp = TString(checkpoint) + ".tmp";
+    TFile* f = TFile::Open(tmp, "RECREATE");
+    gROOT->cd();
+    if (!f || f->IsZombie()) {
+      std::cerr << "Error: cannot write checkpoint " << tmp << std::endl;
+      delete f;
+      return false;
+    }
+    for (size_t k = 0; k < fFills.size(); k++) f->WriteTObject(fFills[k].hist, fFills[k].hist->GetName());
+    for (size_t k = 0; k < fSparse.size(); k++) f->WriteTObject(fSparse[k].hist, fSparse[k].hist->GetName());
+    TNamed input("CheckpointInput", filename);
+    TNamed config("CheckpointConfig", Configuration());
+    TNamed checksum("CheckpointInputChecksum", InputChecksum(filename, fEntries));
+    TParameter<Long64_t> done("CheckpointEntries", fEntries);
+    f->WriteTObject(&input);
+    f->WriteTObject(&config);
+    f->WriteTObject(&checksum);
+    f->WriteTObject(&done);
+    f->Close();
+    delete f;
+    if (gSystem->Rename(tmp, checkpoint) != 0) {
+      std::cerr << "Error: cannot replace checkpoint " << checkpoint << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Sparse histograms stop being filled once their memory passes capMB;
+  // capped tells the caller the result is incomplete
+  Long64_t Loop(ConvertedReader& reader, const std::vector<Fill>& fills,
+                const std::vector<SparseFill>& sparse, EntryRange range,
+                double capMB, bool& capped) const
+  {
+    const Long64_t kCapCheckInterval = 10000;
+    std::vector<double> point;
+    std::vector<int> bins;
+    std::vector<double> poisson;
+    Long64_t naccepted = 0;
+    Row row{};
+    for (Long64_t i = range.begin; i < range.end; i++) {
+      reader.GetEntry(i);
+      if (!fCompute(reader, row)) continue;
+      naccepted++;
+      int npoisson = 0;
+      for (const Fill& f : fills) {
+        if (f.cut && !f.cut(row)) continue;
+        const double w = f.weight ? f.weight(row) : 1.0;
+        if (f.universes) {
+          FillUniverses((TH2D*)f.hist, f.universes(row), w, bins);
+        } else if (f.bootstrap) {
+          // replica weights of this entry, generated once for all histograms
+          const int nreplicas = f.hist->GetNbinsY();
+          if (npoisson < nreplicas) {
+            poisson.resize(nreplicas);
+            PoissonReplicaWeights(i, npoisson, nreplicas, poisson.data());
+            npoisson = nreplicas;
+          }
+          FillReplicas((TH2D*)f.hist, f.x(row), w, poisson.data());
+        }
+        else if (f.is2D) ((TH2*)f.hist)->Fill(f.x(row), f.y(row), w);
+        else f.hist->Fill(f.x(row), w);
+      }
+      if (capped) continue;
+      for (const SparseFill& f : sparse) {
+        if (f.cut && !f.cut(row)) continue;
+        point.resize(f.values.size());
+        for (size_t d = 0; d < point.size(); d++) point[d] = f.values[d](row);
+        f.hist->Fill(point.data(), f.weight ? f.weight(row) : 1.0);
+      }
+      if (capMB > 0 && !sparse.empty() && naccepted % kCapCheckInterval == 0) {
+        double mb = 0;
+        for (const SparseFill& f : sparse) mb += SparseMB(f.hist);
+        capped = mb > capMB;
+      }
+    }
+    return naccepted;
+  }
+
+  // Adds w to bin x of every universe directly in the bin arrays: first
+  // all global bin numbers, then the additions. Statistics such as the
+  // mean are recomputed from the contents after the run.
+  static void FillUniverses(TH2D* h, const double* x, double w, std::vector<int>& bins)
+  {
+    const int nx = h->GetNbinsX(), n = h->GetNbinsY();
+    const double xmin = h->GetXaxis()->GetXmin(), xmax = h->GetXaxis()->GetXmax();
+    const double scale = nx / (xmax - xmin);
+    bins.resize(n);
+    int* b = bins.data();
+    for (int u = 0; u < n; u++) {
+      const double v = x[u];
+      const int bx = !(v >= xmin) ? 0 : v >= xmax ? nx + 1 : 1 + (int)((v - xmin) * scale);
+      b[u] = bx + (nx + 2) * (u + 1);
+    }
+    double* sum = h->GetArray();
+    double* sum2 = h->GetSumw2()->GetArray();
+    for (int u = 0; u < n; u++) {
+      sum[b[u]] += w;
+      sum2[b[u]] += w * w;
+    }
+  }
+
+  void ResetDirectFillStats()
+  {
+    for (size_t k = 0; k < fFills.size(); k++)
+      if (fFills[k].universes || fFills[k].bootstrap) fFills[k].hist->ResetStats();
+  }
+
+  // Cap left for new bins, given what the sparse histograms already hold
+  double SparseCapLeft() const
+  {
+    if (fSparseCapMB <= 0) return 0;
+    double mb = 0;
+    for (const SparseFill& f : fSparse) mb += SparseMB(f.hist);
+    // a tiny positive cap makes the workers stop at their first check
+    return std::max(fSparseCapMB - mb, 1e-9);
+  }
+
+  bool SparseCapError(const char* filename) const
+  {
+    std::cerr << "Error: sparse histograms of " << filename << " passed the memory cap of "
+              << fSparseCapMB << " MB and are incomplete; use coarser binning or a larger cap"
+              << std::endl;
+    return false;
+  }
+
+  ComputeFn fCompute;
+  std::function<void(ConvertedReader&)> fReaderSetup;
+  std::vector<Fill> fFills;
+  std::vector<SparseFill> fSparse;
+  double fSparseCapMB = 0;
+  TString fConfig;
+  Long64_t fAccepted = 0;
+  Long64_t fEntries = 0;
+  Long64_t fGenerated = 0;
+};
+
+#endif
@@ -0,0 +1,66 @@
+//// Lepton-side event kinematics shared by the converter and the analysis
+//// macros. Energies and momenta in GeV.
+#ifndef MC_TUTORIAL_KINEMATICS_H
+#define MC_TUTORIAL_KINEMATICS_H
+
+#include <cmath>
+#include <cstdlib>
+
+#include "pdg_table.h"
+
+// Average of the proton and neutron masses [GeV]
+constexpr double kNucleonMass = 0.5 * (PdgMass(2212) + PdgMass(2112));
+
+struct LeptonKinematics {
+  double q3 = 0;    // |q|, three-momentum transfer
+  double omega = 0; // energy transfer nuE - Elep
+  double Q2 = 0;    // |q|^2 - omega^2, clamped at 0
+  double W = 0;     // hadronic invariant mass on a free nucleon at rest
+  double x = 0;     // Bjorken x
+  double y = 0;     // inelasticity
+};
+
+// Q2, W, x and y from the neutrino energy and the transfers q3, omega
+inline LeptonKinematics TransferKinematics(double nuE, double q3, double omega,
+                                           double mN = kNucleonMass)
+{
+  LeptonKinematics k;
+  k.q3 = q3;
+  k.omega = omega;
+  k.Q2 = k.q3*k.q3 - k.omega*k.omega;
+  if (k.Q2 < 0) k.Q2 = 0;
+  k.y = nuE > 0 ? k.omega / nuE : 0;
+  k.x = (2*mN*k.omega > 0) ? (k.Q2 / (2*mN*k.omega)) : 0;
+  double W2 = mN*mN + 2*mN*k.omega - k.Q2;
+  k.W = W2 > 0 ? std::sqrt(W2) : 0;
+  return k;
+}
+
+// Transfer variables from the neutrino and outgoing lepton four-momenta
+inline LeptonKinematics ComputeLeptonKinematics(double nuE, double nuPx, double nuPy, double nuPz,
+                                                double lepE, double lepPx, double lepPy, double lepPz,
+                                                double mN = kNucleonMass)
+{
+  double qx = nuPx - lepPx;
+  double qy = nuPy - lepPy;
+  double qz = nuPz - lepPz;
+  return TransferKinematics(nuE, std::sqrt(qx*qx + qy*qy + qz*qz), nuE - lepE, mN);
+}
+
+// Contribution of one final-state particle to the visible hadronic energy:
+// kinetic energy for protons, total energy for mesons, photons and other
+// hadrons. Leptons, neutrons and nuclear remnants are not counted.
+inline double VisibleHadronicEnergy(int pdg, double E, double px, double py, double pz)
+{
+  int a = std::abs(pdg);
+  if (a >= 11 && a <= 16) return 0;  // leptons
+  if (a == 2112) return 0;           // neutrons escape unseen
+  if (a >= 1000000000) return 0;     // nuclei and GENIE pseudo-particles
+  if (a == 2212) {
+    double m2 = E*E - (px*px + py*py + pz*pz);
+    return E - (m2 > 0 ? std::sqrt(m2) : 0);
+  }
+  return E;
+}
+
+#endif
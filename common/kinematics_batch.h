@@ -0,0 +1,137 @@
+//// Batched version of ComputeLeptonKinematics for large parameter studies.
+//// Inputs and outputs are structure-of-arrays, one array per quantity, so
+//// the loop runs over contiguous doubles. The Q2 < 0 clamp and the
+//// omega <= 0 / nuE <= 0 cases are handled with masks (selects), never
+//// with branches; the results agree with the scalar function up to
+//// rounding.
+////
+//// With std::experimental::simd (gcc >= 11) the kernel is written with
+//// explicit SIMD types; otherwise (gcc 9 in the container, cling) it falls
+//// back to a plain loop written so that gcc -O3 auto-vectorizes it. gcc
+//// only vectorizes that loop with -fno-math-errno (for the sqrt) and
+//// -fno-trapping-math (for the divisions behind the selects), both set by
+//// the cmake build; for ACLiC see bench/kinematics_kernel.cc.
+////
+//// The kernel pays off when a block of events stays in cache and is
+//// processed many times: scan_nucleon_mass in proj2 reruns it over blocks
+//// of 4096 events for every assumed nucleon mass. Over arrays of millions
+//// of events it is limited by memory bandwidth and gains little or
+//// nothing over the scalar function (bench/kinematics_kernel.cc).
+//// The histogram macros keep the scalar function: they handle one event
+//// at a time and mostly read the converter's precomputed branches.
+#ifndef MC_TUTORIAL_KINEMATICS_BATCH_H
+#define MC_TUTORIAL_KINEMATICS_BATCH_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "kinematics.h"
+
+#if defined(__has_include) && !defined(__CLING__) && !defined(MC_TUTORIAL_NO_STD_SIMD)
+#if __has_include(<experimental/simd>)
+#include <experimental/simd>
+#if defined(__cpp_lib_experimental_parallel_simd)
+#define MC_TUTORIAL_HAVE_STD_SIMD 1
+#endif
+#endif
+#endif
+
+// Neutrino and lepton four-momenta of n events in, transfer variables out
+struct KinematicsBatch {
+  std::vector<double> nuE, nuPx, nuPy, nuPz;
+  std::vector<double> lepE, lepPx, lepPy, lepPz;
+  std::vector<double> q3, omega, Q2, x, y;
+
+  size_t Size() const { return nuE.size(); }
+
+  void Resize(size_t n)
+  {
+    for (std::vector<double>* v : {&nuE, &nuPx, &nuPy, &nuPz, &lepE, &lepPx, &lepPy, &lepPz,
+                                   &q3, &omega, &Q2, &x, &y})
+      v->resize(n);
+  }
+};
+
+// Scalar tail and fallback: same formulas as ComputeLeptonKinematics,
+// with every condition turned into a select after unconditional arithmetic
+inline void ComputeLeptonKinematicsLoop(size_t begin, size_t end,
+                                        const double* __restrict nuE, const double* __restrict nuPx,
+                                        const double* __restrict nuPy, const double* __restrict nuPz,
+                                        const double* __restrict lepE, const double* __restrict lepPx,
+                                        const double* __restrict lepPy, const double* __restrict lepPz,
+                                        double mN,
+                                        double* __restrict q3, double* __restrict omega,
+                                        double* __restrict Q2, double* __restrict x,
+                                        double* __restrict y)
+{
+  for (size_t i = begin; i < end; i++) {
+    double qx = nuPx[i] - lepPx[i];
+    double qy = nuPy[i] - lepPy[i];
+    double qz = nuPz[i] - lepPz[i];
+    double q = std::sqrt(qx*qx + qy*qy + qz*qz);
+    double w = nuE[i] - lepE[i];
+    double Q = q*q - w*w;
+    Q = Q > 0 ? Q : 0.0;
+    double den = 2*mN*w;
+    double xi = Q / (den > 0 ? den : 1.0);
+    double yi = w / (nuE[i] > 0 ? nuE[i] : 1.0);
+    q3[i] = q;
+    omega[i] = w;
+    Q2[i] = Q;
+    x[i] = den > 0 ? xi : 0.0;
+    y[i] = nuE[i] > 0 ? yi : 0.0;
+  }
+}
+
+// gcc 12 reports a false -Wmaybe-uninitialized inside the AVX-512 sqrt of
+// <experimental/simd> when this is inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+inline void ComputeLeptonKinematicsBatch(KinematicsBatch& b, double mN = kNucleonMass)
+{
+  const size_t n = b.Size();
+  size_t done = 0;
+#ifdef MC_TUTORIAL_HAVE_STD_SIMD
+  namespace stdx = std::experimental;
+  typedef stdx::native_simd<double> V;
+  const size_t L = V::size();
+  const V zero(0.0), one(1.0), twoM(2*mN);
+  for (; done + L <= n; done += L) {
+    const size_t i = done;
+    V nuE(&b.nuE[i], stdx::element_aligned), lepE(&b.lepE[i], stdx::element_aligned);
+    V qx = V(&b.nuPx[i], stdx::element_aligned) - V(&b.lepPx[i], stdx::element_aligned);
+    V qy = V(&b.nuPy[i], stdx::element_aligned) - V(&b.lepPy[i], stdx::element_aligned);
+    V qz = V(&b.nuPz[i], stdx::element_aligned) - V(&b.lepPz[i], stdx::element_aligned);
+    V q = stdx::sqrt(qx*qx + qy*qy + qz*qz);
+    V w = nuE - lepE;
+    V Q = stdx::max(q*q - w*w, zero);
+    V den = twoM*w;
+
+    auto xOk = den > zero;
+    auto yOk = nuE > zero;
+    V safeDen = one, safeE = one;
+    stdx::where(xOk, safeDen) = den;
+    stdx::where(yOk, safeE) = nuE;
+    V xv = zero, yv = zero;
+    stdx::where(xOk, xv) = Q / safeDen;
+    stdx::where(yOk, yv) = w / safeE;
+
+    q.copy_to(&b.q3[i], stdx::element_aligned);
+    w.copy_to(&b.omega[i], stdx::element_aligned);
+    Q.copy_to(&b.Q2[i], stdx::element_aligned);
+    xv.copy_to(&b.x[i], stdx::element_aligned);
+    yv.copy_to(&b.y[i], stdx::element_aligned);
+  }
+#endif
+  ComputeLeptonKinematicsLoop(done, n, b.nuE.data(), b.nuPx.data(), b.nuPy.data(), b.nuPz.data(),
+                              b.lepE.data(), b.lepPx.data(), b.lepPy.data(), b.lepPz.data(), mN,
+                              b.q3.data(), b.omega.data(), b.Q2.data(), b.x.data(), b.y.data());
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+//// Process memory probes for long conversion and analysis jobs (Linux).
+//// Logs resident memory, its peak, and the net heap growth per event since
+//// the previous log line; a flat RSS and ~0 bytes/event mean no leak.
+#ifndef MC_TUTORIAL_MEMORY_MONITOR_H
+#define MC_TUTORIAL_MEMORY_MONITOR_H
+
+#include <cstdio>
+#include <string>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Current resident set size in MB
+inline double CurrentRSSMB()
+{
+  long pages = 0, resident = 0;
+  FILE* f = std::fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  std::fclose(f);
+  return resident * (double)sysconf(_SC_PAGESIZE) / (1024.0*1024.0);
+}
+
+// Peak resident set size of the process in MB. The kernel updates its
+// high-water mark lazily, so the current RSS can be slightly above it.
+inline double PeakRSSMB()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double peak = usage.ru_maxrss / 1024.0; // ru_maxrss is in kB on Linux
+  double now = CurrentRSSMB();
+  return peak > now ? peak : now;
+}
+
+// Bytes currently allocated through malloc
+inline double HeapInUseBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2();
+#else
+  struct mallinfo mi = mallinfo(); // int fields, wrap above 2 GB
+#endif
+  return (double)mi.uordblks + (double)mi.hblkhd;
+}
+
+class MemoryMonitor {
+public:
+  explicit MemoryMonitor(const std::string& label)
+    : fLabel(label), fLastHeap(HeapInUseBytes()) {}
+
+  // Print one line for nevents processed so far
+  void Log(long long nevents)
+  {
+    double heap = HeapInUseBytes();
+    long long delta = nevents - fLastEvents;
+    double growth = delta > 0 ? (heap - fLastHeap) / delta : 0;
+    std::printf("%s: %lld events, RSS %.1f MB, peak RSS %.1f MB, heap %.1f MB, %+.1f heap bytes/event\n",
+                fLabel.c_str(), nevents, CurrentRSSMB(), PeakRSSMB(), heap/(1024.0*1024.0), growth);
+    std::fflush(stdout);
+    fLastHeap = heap;
+    fLastEvents = nevents;
+  }
+
+private:
+  std::string fLabel;
+  double fLastHeap;
+  long long fLastEvents = 0;
+};
+
+#endif
@@ -0,0 +1,172 @@
+//// Per-event oscillation weights stored next to a converted file.
+//// For "x.root" the weights go to "x_oscw.root". Every weight column is a
+//// separate one-branch tree named <column>_<key>, where the key is a hash
+//// of the column name, of the input file's identity (path, size and
+//// modification time) and of exactly the parameters the column depends on.
+//// A run asks for the key of its current parameters: if the tree exists
+//// (and has one entry per event) it is read back instead of recomputing the
+//// probabilities, otherwise the column is computed and replaces the older
+//// version of the same column. Changing the density therefore invalidates
+//// the matter columns but keeps the vacuum one, and a rewritten or
+//// appended input file invalidates all of them.
+////
+//// The trees have the same entry order as the events, so for the TTree
+//// layouts they can also be used as friends, e.g.
+////   Event->AddFriend("Pexact_<key>", "x_oscw.root");
+////   Event->Draw("nuE", "xsection*Pexact");
+//// HistEngine analyses read a stored column the same way, entry by entry
+//// (ConvertedReader::AddFriendColumn), and otherwise compute the weight per
+//// event from an OscTable, so no column is ever held in memory.
+#ifndef MC_TUTORIAL_OSC_WEIGHTS_H
+#define MC_TUTORIAL_OSC_WEIGHTS_H
+
+#include <TFile.h>
+#include <TKey.h>
+#include <TROOT.h>
+#include <TString.h>
+#include <TSystem.h>
+#include <TTree.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "oscillation.h"
+
+// Path, size and modification time of a file
+inline std::string InputFileId(const char* inputFile)
+{
+  FileStat_t st;
+  gSystem->GetPathInfo(inputFile, st);
+  return TString::Format("%s;size=%lld;mtime=%ld", inputFile, st.fSize, st.fMtime).Data();
+}
+
+// FNV-1a hash of the column name, the input file identity and the bit
+// patterns of the parameters
+inline std::string OscWeightKey(const char* column, const char* inputFile, std::initializer_list<double> params)
+{
+  uint64_t h = 14695981039346656037ULL;
+  auto mix = [&h](const void* data, size_t n) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < n; i++) {
+      h ^= p[i];
+      h *= 1099511628211ULL;
+    }
+  };
+  mix(column, strlen(column));
+  const std::string id = InputFileId(inputFile);
+  mix(id.data(), id.size());
+  for (double v : params) mix(&v, sizeof(v));
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+  return buf;
+}
+
+class OscWeightFile {
+public:
+  explicit OscWeightFile(const char* inputFile) : fPath(WeightPath(inputFile)) {}
+
+  static std::string WeightPath(const char* inputFile)
+  {
+    TString path(inputFile);
+    if (path.EndsWith(".root")) path.Remove(path.Length() - 5);
+    path += "_oscw.root";
+    return path.Data();
+  }
+
+  const std::string& Path() const { return fPath; }
+
+  // Whether a column is stored for this key with nentries entries
+  bool Has(const char* column, const std::string& key, Long64_t nentries) const
+  {
+    if (gSystem->AccessPathName(fPath.c_str())) return false; // no weight file yet
+    TFile* f = TFile::Open(fPath.c_str(), "READ");
+    gROOT->cd();
+    TTree* t = f && !f->IsZombie() ? f->Get<TTree>(TreeName(column, key).c_str()) : nullptr;
+    const bool ok = t && t->GetEntries() == nentries;
+    if (f) f->Close();
+    delete f;
+    return ok;
+  }
+
+  // Stored column for this key, false if there is none or it does not have
+  // nentries entries (the input changed since it was written)
+  bool Read(const char* column, const std::string& key, Long64_t nentries, std::vector<double>& w) const
+  {
+    if (gSystem->AccessPathName(fPath.c_str())) return false; // no weight file yet
+    TFile* f = TFile::Open(fPath.c_str(), "READ");
+    gROOT->cd();
+    bool ok = false;
+    TTree* t = f && !f->IsZombie() ? f->Get<TTree>(TreeName(column, key).c_str()) : nullptr;
+    if (t && t->GetEntries() == nentries) {
+      double v = 0;
+      t->SetBranchAddress(column, &v);
+      w.resize(nentries);
+      for (Long64_t i = 0; i < nentries; i++) {
+        t->GetEntry(i);
+        w[i] = v;
+      }
+      ok = true;
+    }
+    if (f) f->Close();
+    delete f;
+    return ok;
+  }
+
+  // Store a column, replacing older versions of it; other columns are kept
+  bool Write(const char* column, const std::string& key, const char* title, const std::vector<double>& w) const
+  {
+    TFile* f = TFile::Open(fPath.c_str(), "UPDATE");
+    gROOT->cd();
+    if (!f || f->IsZombie()) {
+      std::cerr << "Error: cannot write oscillation weights to " << fPath << std::endl;
+      delete f;
+      return false;
+    }
+    const TString prefix = TString(column) + "_";
+    std::vector<TString> stale;
+    TIter next(f->GetListOfKeys());
+    while (TKey* k = (TKey*)next())
+      if (TString(k->GetName()).BeginsWith(prefix)) stale.push_back(k->GetName());
+    for (const TString& name : stale) f->Delete(name + ";*");
+
+    TTree* t = new TTree(TreeName(column, key).c_str(), title);
+    t->SetDirectory(f);
+    double v = 0;
+    t->Branch(column, &v);
+    for (double x : w) {
+      v = x;
+      t->Fill();
+    }
+    t->Write();
+    f->Close(); // also deletes the tree
+    delete f;
+    return true;
+  }
+
+  static std::string TreeName(const char* column, const std::string& key)
+  {
+    return std::string(column) + "_" + key;
+  }
+
+private:
+  std::string fPath;
+};
+
+// Exact survival probability of the event's own flavour (1 for anything
+// that is not a neutrino), from tables for neutrinos [0] and antineutrinos [1]
+inline double ExactSurvivalWeight(const OscTable table[2], int nupdg, double E)
+{
+  const int f = NeutrinoFlavour(nupdg);
+  return f < 0 ? 1.0 : table[nupdg < 0].Prob(f, f, E);
+}
+
+inline std::string ExactWeightKey(const char* inputFile, const OscParams& p, double Lkm, double rho, double Ye)
+{
+  return OscWeightKey("Pexact", inputFile, {Lkm, rho, Ye, p.th12, p.th13, p.th23, p.dm21, p.dm31, p.dcp});
+}
+
+#endif
@@ -0,0 +1,261 @@
+//// Exact three-flavour neutrino oscillations in constant-density matter.
+//// The flavour-basis Hamiltonian (times 2E, in eV^2)
+////   H = U diag(0, dm21, dm31) U^+ + diag(A, 0, 0),  A = 2 sqrt(2) G_F N_e E
+//// is diagonalised analytically (a 3x3 Hermitian matrix has a closed form
+//// for its eigenvalues), and the evolution matrix
+////   S = exp(-i H L / 2E) = sum_k exp(-i phi_k) prod_{j!=k} (H - l_j)/(l_k - l_j)
+//// follows without eigenvectors. P(a -> b) = |S_ba|^2. Antineutrinos use
+//// U* and -A. Flavours are 0 = e, 1 = mu, 2 = tau.
+////
+//// OscTable evaluates this once on a fine energy grid for one parameter
+//// set, so per-event probabilities are an interpolation instead of a
+//// matrix calculation. Units: energies in GeV, baselines in km, density
+//// in g/cm3, mass splittings in eV^2, angles in radians.
+#ifndef MC_TUTORIAL_OSCILLATION_H
+#define MC_TUTORIAL_OSCILLATION_H
+
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <vector>
+
+// A[eV^2] = kMatterPotential * rho[g/cm3] * Ye * E[GeV], as in osc_approx_matter
+const double kMatterPotential = 1.512e-4;
+// Phase of eigenvalue l[eV^2] after L[km] at E[GeV]: l L / 2E in natural units
+const double kPhasePerEv2KmGeV = 2.534;
+
+struct OscParams {
+  double th12, th13, th23; // mixing angles
+  double dm21, dm31;       // mass splittings, dm31 < 0 for inverted ordering
+  double dcp;              // CP phase
+};
+
+// Parameters used by the macros (normal ordering), the same values as the
+// constants in osc_approx_matter.cc
+inline OscParams NominalOscParams()
+{
+  return {33.44 * M_PI/180.0, 8.57 * M_PI/180.0, 49.2 * M_PI/180.0, 7.42e-5, 2.517e-3, 197.0 * M_PI/180.0};
+}
+
+typedef std::complex<double> Complex;
+
+struct Matrix3 {
+  Complex m[3][3];
+
+  static Matrix3 Identity()
+  {
+    Matrix3 r;
+    for (int i = 0; i < 3; i++) r.m[i][i] = 1;
+    return r;
+  }
+
+  Matrix3 operator*(const Matrix3& b) const
+  {
+    Matrix3 r;
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        r.m[i][j] = m[i][0]*b.m[0][j] + m[i][1]*b.m[1][j] + m[i][2]*b.m[2][j];
+    return r;
+  }
+};
+
+// Flavour index from a PDG code, -1 if not a neutrino
+inline int NeutrinoFlavour(int pdg)
+{
+  switch (std::abs(pdg)) {
+    case 12: return 0;
+    case 14: return 1;
+    case 16: return 2;
+  }
+  return -1;
+}
+
+// PMNS matrix in the standard parametrisation
+inline Matrix3 PMNSMatrix(const OscParams& p)
+{
+  const double s12 = std::sin(p.th12), c12 = std::cos(p.th12);
+  const double s13 = std::sin(p.th13), c13 = std::cos(p.th13);
+  const double s23 = std::sin(p.th23), c23 = std::cos(p.th23);
+  const Complex eid = std::polar(1.0, p.dcp);  // e^{+i delta}
+  const Complex emid = std::conj(eid);         // e^{-i delta}
+  Matrix3 U;
+  U.m[0][0] = c12*c13;
+  U.m[0][1] = s12*c13;
+  U.m[0][2] = s13*emid;
+  U.m[1][0] = -s12*c23 - c12*s23*s13*eid;
+  U.m[1][1] = c12*c23 - s12*s23*s13*eid;
+  U.m[1][2] = s23*c13;
+  U.m[2][0] = s12*s23 - c12*c23*s13*eid;
+  U.m[2][1] = -c12*s23 - s12*c23*s13*eid;
+  U.m[2][2] = c23*c13;
+  return U;
+}
+
+// Vacuum part U diag(0, dm21, dm31) U^+ of 2E*H [eV^2]; it does not depend
+// on energy or density, so it is computed once per parameter set
+inline Matrix3 VacuumHamiltonian(const OscParams& p, bool antineutrino)
+{
+  Matrix3 U = PMNSMatrix(p);
+  if (antineutrino)
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++) U.m[i][j] = std::conj(U.m[i][j]);
+  const double m2[3] = {0, p.dm21, p.dm31};
+  Matrix3 H;
+  for (int a = 0; a < 3; a++)
+    for (int b = 0; b < 3; b++)
+      for (int k = 0; k < 3; k++) H.m[a][b] += U.m[a][k] * m2[k] * std::conj(U.m[b][k]);
+  return H;
+}
+
+// Eigenvalues of a Hermitian 3x3 matrix, closed (trigonometric) form
+inline void HermitianEigenvalues(const Matrix3& H, double l[3])
+{
+  const double q = (H.m[0][0].real() + H.m[1][1].real() + H.m[2][2].real()) / 3;
+  Matrix3 B = H;
+  for (int i = 0; i < 3; i++) B.m[i][i] -= q;
+  double p2 = 0;
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) p2 += std::norm(B.m[i][j]);
+  const double p = std::sqrt(p2 / 6);
+  if (p == 0) {
+    l[0] = l[1] = l[2] = q;
+    return;
+  }
+  const Complex det = B.m[0][0]*(B.m[1][1]*B.m[2][2] - B.m[1][2]*B.m[2][1])
+                    - B.m[0][1]*(B.m[1][0]*B.m[2][2] - B.m[1][2]*B.m[2][0])
+                    + B.m[0][2]*(B.m[1][0]*B.m[2][1] - B.m[1][1]*B.m[2][0]);
+  double r = det.real() / (2*p*p*p);
+  r = r < -1 ? -1 : (r > 1 ? 1 : r);
+  const double phi = std::acos(r) / 3;
+  l[0] = q + 2*p*std::cos(phi);
+  l[2] = q + 2*p*std::cos(phi + 2*M_PI/3);
+  l[1] = 3*q - l[0] - l[2];
+}
+
+// Spectral form of 2E*H: eigenvalues l_k and projectors
+//   P_k = prod_{j!=k} (H - l_j)/(l_k - l_j)
+// so that exp(-i H L / 2E) = sum_k exp(-i phi_k) P_k for any L. The three
+// eigenvalues of a neutrino Hamiltonian are always distinct (dm21 != 0).
+struct SpectralHamiltonian {
+  double l[3];
+  Matrix3 P[3];
+
+  // S = exp(-i H L / 2E); only three phases once the projectors are known
+  Matrix3 Evolve(double Lkm, double E) const
+  {
+    const double scale = kPhasePerEv2KmGeV * Lkm / E;
+    Matrix3 S;
+    for (int k = 0; k < 3; k++) {
+      const Complex ph = std::polar(1.0, -scale * l[k]);
+      for (int a = 0; a < 3; a++)
+        for (int b = 0; b < 3; b++) S.m[a][b] += ph * P[k].m[a][b];
+    }
+    return S;
+  }
+};
+
+inline SpectralHamiltonian Decompose(const Matrix3& H)
+{
+  SpectralHamiltonian d;
+  HermitianEigenvalues(H, d.l);
+  const Matrix3 H2 = H * H;
+  for (int k = 0; k < 3; k++) {
+    const int j = (k + 1) % 3, n = (k + 2) % 3;
+    // (H - l_j)(H - l_n) / ((l_k - l_j)(l_k - l_n))
+    const double norm = 1.0 / ((d.l[k] - d.l[j]) * (d.l[k] - d.l[n]));
+    const double sum = d.l[j] + d.l[n], prod = d.l[j] * d.l[n];
+    for (int a = 0; a < 3; a++)
+      for (int b = 0; b < 3; b++)
+        d.P[k].m[a][b] = norm * (H2.m[a][b] - sum*H.m[a][b] + (a == b ? prod : 0.0));
+  }
+  return d;
+}
+
+// S = exp(-i H L / 2E) for 2E*H in eV^2
+inline Matrix3 EvolutionMatrix(const Matrix3& H, double Lkm, double E)
+{
+  return Decompose(H).Evolve(Lkm, E);
+}
+
+// 2E*H in matter of density rho at energy E
+inline Matrix3 MatterHamiltonian(const Matrix3& Hvac, double E, double rho, double Ye, bool antineutrino)
+{
+  Matrix3 H = Hvac;
+  const double A = kMatterPotential * rho * Ye * E;
+  H.m[0][0] += antineutrino ? -A : A;
+  return H;
+}
+
+// All nine probabilities P[from][to] at one energy
+inline void OscProbabilities(const Matrix3& Hvac, double E, double Lkm, double rho, double Ye,
+                             bool antineutrino, double P[3][3])
+{
+  const Matrix3 S = EvolutionMatrix(MatterHamiltonian(Hvac, E, rho, Ye, antineutrino), Lkm, E);
+  for (int a = 0; a < 3; a++)
+    for (int b = 0; b < 3; b++) P[a][b] = std::norm(S.m[b][a]);
+}
+
+// P(from -> to) for one energy; builds the Hamiltonian from scratch, use
+// OscTable for many events
+inline double OscProbability(const OscParams& p, int from, int to, double E, double Lkm,
+                             double rho, double Ye, bool antineutrino)
+{
+  if (E <= 0) return from == to ? 1.0 : 0.0;
+  double P[3][3];
+  OscProbabilities(VacuumHamiltonian(p, antineutrino), E, Lkm, rho, Ye, antineutrino, P);
+  return P[from][to];
+}
+
+// Probabilities on a grid uniform in 1/E between Emin and Emax, where the
+// oscillation phase is (nearly) linear, so linear interpolation is accurate
+// with a few thousand nodes even at low energy. Outside the grid the exact
+// calculation is used.
+class OscTable {
+public:
+  OscTable() {}
+
+  void Build(const OscParams& p, double Lkm, double rho, double Ye, bool antineutrino,
+             double Emin = 0.05, double Emax = 20.0, int nodes = 4000)
+  {
+    fParams = p;
+    fL = Lkm; fRho = rho; fYe = Ye; fAnti = antineutrino;
+    fInvMin = 1.0 / Emax;
+    fStep = (1.0 / Emin - fInvMin) / (nodes - 1);
+    fHvac = VacuumHamiltonian(p, antineutrino);
+    fP.assign(9 * nodes, 0);
+    double P[3][3];
+    for (int n = 0; n < nodes; n++) {
+      OscProbabilities(fHvac, 1.0 / (fInvMin + n*fStep), Lkm, rho, Ye, antineutrino, P);
+      for (int a = 0; a < 3; a++)
+        for (int b = 0; b < 3; b++) fP[9*n + 3*a + b] = P[a][b];
+    }
+  }
+
+  int Nodes() const { return fP.size() / 9; }
+  bool IsAntineutrino() const { return fAnti; }
+
+  double Prob(int from, int to, double E) const
+  {
+    if (E <= 0) return from == to ? 1.0 : 0.0;
+    const double u = (1.0 / E - fInvMin) / fStep;
+    const int n = (int)u;
+    if (u < 0 || n >= Nodes() - 1) {
+      double P[3][3];
+      OscProbabilities(fHvac, E, fL, fRho, fYe, fAnti, P);
+      return P[from][to];
+    }
+    const double f = u - n;
+    const int k = 3*from + to;
+    return (1 - f) * fP[9*n + k] + f * fP[9*(n + 1) + k];
+  }
+
+private:
+  OscParams fParams{};
+  double fL = 0, fRho = 0, fYe = 0;
+  bool fAnti = false;
+  double fInvMin = 0, fStep = 1;
+  Matrix3 fHvac;
+  std::vector<double> fP; // 9 probabilities per node, [node][from][to]
+};
+
+#endif
@@ -0,0 +1,91 @@
+//// Masses and charges of the final-state particles the macros look at,
+//// known at compile time. The lookup is a perfect hash: |pdg| % 79 is
+//// different for every code in the list (checked by a static_assert), so a
+//// lookup is one modulo, one small-table load and one compare, with no
+//// branches over the particle type. Antiparticles (negative codes) have
+//// the same mass and the opposite charge. Masses in GeV.
+#ifndef MC_TUTORIAL_PDG_TABLE_H
+#define MC_TUTORIAL_PDG_TABLE_H
+
+#include <cstdlib>
+
+struct PdgInfo {
+  int pdg;     // particle code (positive)
+  double mass; // GeV
+  int charge;  // in units of e
+};
+
+constexpr PdgInfo kPdgInfo[] = {
+  {11, 0.000510999, -1},   // e-
+  {12, 0.0, 0},            // nu_e
+  {13, 0.105658375, -1},   // mu-
+  {14, 0.0, 0},            // nu_mu
+  {15, 1.77686, -1},       // tau-
+  {16, 0.0, 0},            // nu_tau
+  {22, 0.0, 0},            // gamma
+  {111, 0.1349768, 0},     // pi0
+  {211, 0.13957039, 1},    // pi+
+  {130, 0.497611, 0},      // K0_L
+  {310, 0.497611, 0},      // K0_S
+  {311, 0.497611, 0},      // K0
+  {321, 0.493677, 1},      // K+
+  {2112, 0.93956542, 0},   // n
+  {2212, 0.93827209, 1},   // p
+  {3122, 1.115683, 0},     // Lambda
+  {3222, 1.18937, 1},      // Sigma+
+  {3212, 1.192642, 0},     // Sigma0
+  {3112, 1.197449, -1},    // Sigma-
+};
+
+constexpr int kPdgCount = sizeof(kPdgInfo) / sizeof(kPdgInfo[0]);
+constexpr int kPdgHashSize = 79;
+
+// Slot of every code, kPdgCount for empty slots
+struct PdgHashTable {
+  unsigned char slot[kPdgHashSize];
+};
+
+constexpr PdgHashTable MakePdgHashTable()
+{
+  PdgHashTable t{};
+  for (int h = 0; h < kPdgHashSize; h++) t.slot[h] = kPdgCount;
+  for (int k = 0; k < kPdgCount; k++) t.slot[kPdgInfo[k].pdg % kPdgHashSize] = k;
+  return t;
+}
+
+constexpr PdgHashTable kPdgHash = MakePdgHashTable();
+
+constexpr bool PdgHashIsPerfect()
+{
+  for (int k = 0; k < kPdgCount; k++)
+    if (kPdgHash.slot[kPdgInfo[k].pdg % kPdgHashSize] != k) return false;
+  return true;
+}
+static_assert(PdgHashIsPerfect(), "two PDG codes share a hash slot, change kPdgHashSize");
+
+// Entry for a code, nullptr if it is not in the table (nuclei, GENIE
+// pseudo-particles, ...)
+constexpr const PdgInfo* FindPdg(int pdg)
+{
+  const int a = pdg < 0 ? -pdg : pdg;
+  const int k = kPdgHash.slot[a % kPdgHashSize];
+  return k < kPdgCount && kPdgInfo[k].pdg == a ? &kPdgInfo[k] : nullptr;
+}
+
+// Mass [GeV], negative if unknown
+constexpr double PdgMass(int pdg)
+{
+  const PdgInfo* p = FindPdg(pdg);
+  return p ? p->mass : -1;
+}
+
+constexpr int PdgCharge(int pdg)
+{
+  const PdgInfo* p = FindPdg(pdg);
+  return p ? (pdg < 0 ? -p->charge : p->charge) : 0;
+}
+
+static_assert(PdgMass(2212) > 0.938 && PdgMass(-13) > 0.105 && PdgMass(1000180400) < 0,
+              "PDG table lookup");
+
+#endif
@@ -0,0 +1,194 @@
+//// Detector response as a sparse matrix for folding true-energy spectra.
+//// Built from a 2D histogram with the true variable on x and the
+//// reconstructed one on y (h_resp in reconstruct_energy.cc). Column t holds
+//// the probability that an event in true bin t is reconstructed in each
+//// reco bin; it is normalised to all events of that true bin, including
+//// those reconstructed outside the y range, so a column sums to the
+//// fraction that stays in range.
+////
+//// Storage is CSR by reco bin (row): for every row the nonzero true bins
+//// and their probabilities, contiguous. Folding
+////   reco[r] = sum_t R[r][t] * truth[t]
+//// writes every output once and reads the input nearly in order, because
+//// the response is close to diagonal. FoldBatch folds many spectra in one
+//// pass over the matrix; the spectra are stored bin-major ([bin][spectrum])
+//// so the inner loop runs over contiguous spectra and vectorizes.
+#ifndef MC_TUTORIAL_RESPONSE_MATRIX_H
+#define MC_TUTORIAL_RESPONSE_MATRIX_H
+
+#include <TDirectory.h>
+#include <TH1D.h>
+#include <TH2.h>
+#include <TTree.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+class ResponseMatrix {
+public:
+  ResponseMatrix() {}
+
+  // Entries below threshold (as a probability) are dropped
+  bool FromHist(const TH2* h, double threshold = 0)
+  {
+    fNTrue = h->GetNbinsX();
+    fNReco = h->GetNbinsY();
+    fTrueEdges.resize(fNTrue + 1);
+    fRecoEdges.resize(fNReco + 1);
+    for (int t = 0; t <= fNTrue; t++) fTrueEdges[t] = h->GetXaxis()->GetBinLowEdge(t + 1);
+    for (int r = 0; r <= fNReco; r++) fRecoEdges[r] = h->GetYaxis()->GetBinLowEdge(r + 1);
+
+    std::vector<double> column(fNTrue, 0);
+    for (int t = 0; t < fNTrue; t++)
+      for (int r = 0; r <= fNReco + 1; r++) column[t] += h->GetBinContent(t + 1, r);
+
+    fRowStart.assign(1, 0);
+    fCol.clear();
+    fValue.clear();
+    for (int r = 0; r < fNReco; r++) {
+      for (int t = 0; t < fNTrue; t++) {
+        if (column[t] <= 0) continue;
+        const double p = h->GetBinContent(t + 1, r + 1) / column[t];
+        if (p == 0 || p < threshold) continue;
+        fCol.push_back(t);
+        fValue.push_back(p);
+      }
+      fRowStart.push_back(fCol.size());
+    }
+    return fNTrue > 0 && fNReco > 0;
+  }
+
+  int NTrue() const { return fNTrue; }
+  int NReco() const { return fNReco; }
+  size_t NonZeros() const { return fValue.size(); }
+  const std::vector<double>& TrueEdges() const { return fTrueEdges; }
+  const std::vector<double>& RecoEdges() const { return fRecoEdges; }
+  // CSR arrays plus the two sets of bin edges
+  size_t MemoryBytes() const
+  {
+    return fValue.size() * (sizeof(double) + sizeof(int)) + fRowStart.size() * sizeof(int)
+         + (fTrueEdges.size() + fRecoEdges.size()) * sizeof(double);
+  }
+
+  // reco[NReco()] from truth[NTrue()]
+  void Fold(const double* truth, double* reco) const
+  {
+    for (int r = 0; r < fNReco; r++) {
+      double sum = 0;
+      for (int k = fRowStart[r]; k < fRowStart[r + 1]; k++) sum += fValue[k] * truth[fCol[k]];
+      reco[r] = sum;
+    }
+  }
+
+  // truth[t] = sum_r R[r][t] * reco[r], the transposed product
+  void FoldTransposed(const double* reco, double* truth) const
+  {
+    std::fill(truth, truth + fNTrue, 0.0);
+    for (int r = 0; r < fNReco; r++) {
+      const double x = reco[r];
+      if (x == 0) continue;
+      for (int k = fRowStart[r]; k < fRowStart[r + 1]; k++) truth[fCol[k]] += fValue[k] * x;
+    }
+  }
+
+  // Fraction of every true bin reconstructed inside the reco range
+  std::vector<double> Efficiency() const
+  {
+    std::vector<double> eff(fNTrue, 0);
+    for (size_t k = 0; k < fValue.size(); k++) eff[fCol[k]] += fValue[k];
+    return eff;
+  }
+
+  // nspectra spectra at once, truth[NTrue() * nspectra] and
+  // reco[NReco() * nspectra], both [bin][spectrum]
+  void FoldBatch(const double* truth, int nspectra, double* reco) const
+  {
+    for (int r = 0; r < fNReco; r++) {
+      double* out = reco + (size_t)r * nspectra;
+      std::fill(out, out + nspectra, 0.0);
+      for (int k = fRowStart[r]; k < fRowStart[r + 1]; k++) {
+        const double v = fValue[k];
+        const double* in = truth + (size_t)fCol[k] * nspectra;
+        for (int s = 0; s < nspectra; s++) out[s] += v * in[s];
+      }
+    }
+  }
+
+  // Folded histogram with the reco binning; truth must have the true binning
+  TH1D* Fold(const TH1* truth, const char* name) const
+  {
+    if (truth->GetNbinsX() != fNTrue) {
+      std::cerr << "Error: " << truth->GetName() << " has " << truth->GetNbinsX()
+                << " bins, the response has " << fNTrue << " true bins" << std::endl;
+      return nullptr;
+    }
+    std::vector<double> in(fNTrue), out(fNReco);
+    for (int t = 0; t < fNTrue; t++) in[t] = truth->GetBinContent(t + 1);
+    Fold(in.data(), out.data());
+    TH1D* h = new TH1D(name, truth->GetTitle(), fNReco, fRecoEdges.data());
+    for (int r = 0; r < fNReco; r++) h->SetBinContent(r + 1, out[r]);
+    return h;
+  }
+
+  // One-entry tree holding the CSR arrays and the bin edges
+  void Write(TDirectory* dir, const char* name) const
+  {
+    TDirectory* saved = gDirectory;
+    dir->cd();
+    TTree* t = new TTree(name, "sparse response matrix (CSR by reco bin)");
+    int ntrue = fNTrue, nreco = fNReco;
+    std::vector<int> rowStart = fRowStart, col = fCol;
+    std::vector<double> value = fValue, trueEdges = fTrueEdges, recoEdges = fRecoEdges;
+    t->Branch("nTrue", &ntrue);
+    t->Branch("nReco", &nreco);
+    t->Branch("rowStart", &rowStart);
+    t->Branch("col", &col);
+    t->Branch("value", &value);
+    t->Branch("trueEdges", &trueEdges);
+    t->Branch("recoEdges", &recoEdges);
+    t->Fill();
+    t->Write();
+    delete t;
+    saved->cd();
+  }
+
+  bool Read(TDirectory* dir, const char* name)
+  {
+    TTree* t = dir->Get<TTree>(name);
+    if (!t) {
+      std::cerr << "Error: cannot find response matrix " << name << std::endl;
+      return false;
+    }
+    std::vector<int> *rowStart = nullptr, *col = nullptr;
+    std::vector<double> *value = nullptr, *trueEdges = nullptr, *recoEdges = nullptr;
+    t->SetBranchAddress("nTrue", &fNTrue);
+    t->SetBranchAddress("nReco", &fNReco);
+    t->SetBranchAddress("rowStart", &rowStart);
+    t->SetBranchAddress("col", &col);
+    t->SetBranchAddress("value", &value);
+    t->SetBranchAddress("trueEdges", &trueEdges);
+    t->SetBranchAddress("recoEdges", &recoEdges);
+    t->GetEntry(0);
+    fRowStart = *rowStart;
+    fCol = *col;
+    fValue = *value;
+    fTrueEdges = *trueEdges;
+    fRecoEdges = *recoEdges;
+    t->ResetBranchAddresses();
+    delete rowStart;
+    delete col;
+    delete value;
+    delete trueEdges;
+    delete recoEdges;
+    return true;
+  }
+
+private:
+  int fNTrue = 0, fNReco = 0;
+  std::vector<int> fRowStart; // NReco() + 1 offsets into fCol / fValue
+  std::vector<int> fCol;      // true bin of every nonzero
+  std::vector<double> fValue; // probability of every nonzero
+  std::vector<double> fTrueEdges, fRecoEdges;
+};
+
+#endif
@@ -0,0 +1,96 @@
+//// Systematic variations of the energy reconstruction evaluated as
+//// "universes" in one pass. Universe 0 has the nominal constants; every
+//// other universe shifts the binding energy, the neutron and proton masses
+//// and the calorimetric energy scale by Gaussian amounts drawn once from a
+//// fixed seed, so a rerun gives the same universes.
+////
+//// Evaluate decodes the current event once (calorimetric sum, muon
+//// kinematics as for the CCQE estimator) and then computes the energies
+//// of all universes from those numbers. The universe constants are
+//// stored as separate arrays and the outputs are contiguous arrays over
+//// universes, so the per-universe loops are branch-free arithmetic over
+//// arrays. The arrays go into a Row and are filled with
+//// HistEngine::BookUniverses.
+#ifndef MC_TUTORIAL_SYST_UNIVERSES_H
+#define MC_TUTORIAL_SYST_UNIVERSES_H
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "converted_reader.h"
+#include "energy_estimators.h"
+#include "pdg_table.h"
+
+// Size of the per-event universe arrays in a Row
+const int kMaxUniverses = 100;
+
+class SystUniverses {
+public:
+  // n universes (at most kMaxUniverses); widths in GeV, the scale width
+  // is relative
+  bool Generate(int n, unsigned seed = 1, double sigmaEb = 0.006, double sigmaMass = 0.005,
+                double sigmaScale = 0.05)
+  {
+    if (n < 1 || n > kMaxUniverses) {
+      std::cerr << "Error: number of universes must be between 1 and " << kMaxUniverses << std::endl;
+      return false;
+    }
+    fEb.assign(n, kBindingEnergy);
+    fMn.assign(n, PdgMass(2112));
+    fMp.assign(n, PdgMass(2212));
+    fScale.assign(n, 1.0);
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<double> gaus;
+    for (int u = 1; u < n; u++) {
+      fEb[u] += sigmaEb * gaus(rng);
+      fMn[u] += sigmaMass * gaus(rng);
+      fMp[u] += sigmaMass * gaus(rng);
+      fScale[u] += sigmaScale * gaus(rng);
+    }
+    return true;
+  }
+
+  int N() const { return fEb.size(); }
+  double Eb(int u) const { return fEb[u]; }
+  double Mn(int u) const { return fMn[u]; }
+  double Mp(int u) const { return fMp[u]; }
+  double Scale(int u) const { return fScale[u]; }
+
+  // Calorimetric and CCQE energies [GeV] of the current event in every
+  // universe, Ecal[N()] and Eqe[N()]; Eqe is -1 without a final-state muon
+  void Evaluate(const ConvertedReader& r, double* Ecal, double* Eqe) const
+  {
+    const int n = N();
+    const double* scale = fScale.data();
+    const double* Eb = fEb.data();
+    const double* Mn = fMn.data();
+    const double* Mp = fMp.data();
+
+    const double cal = CalorimetricEstimator::Estimate(r);
+    for (int u = 0; u < n; u++) Ecal[u] = scale[u] * cal;
+
+    const int j = FindFinalState(r, CCQEEstimator::kLeptonPdg);
+    const double p = j < 0 ? 0 : std::sqrt(r.Px(j)*r.Px(j) + r.Py(j)*r.Py(j) + r.Pz(j)*r.Pz(j));
+    if (p <= 0) {
+      for (int u = 0; u < n; u++) Eqe[u] = -1;
+      return;
+    }
+    const double El = r.Energy(j), costh = r.Pz(j) / p, ml = PdgMass(r.Pdg(j));
+    for (int u = 0; u < n; u++) Eqe[u] = CCQEEstimator::FromLepton(El, p, costh, ml, Eb[u], Mn[u], Mp[u]);
+  }
+
+  void Print(int nshow = 5) const
+  {
+    for (int u = 0; u < N() && u < nshow; u++)
+      std::cout << "  universe " << u << ": Eb " << fEb[u] * 1e3 << " MeV, Mn " << fMn[u]
+                << " GeV, Mp " << fMp[u] << " GeV, scale " << fScale[u] << std::endl;
+    if (N() > nshow) std::cout << "  ... " << N() - nshow << " more" << std::endl;
+  }
+
+private:
+  std::vector<double> fEb, fMn, fMp, fScale;
+};
+
+#endif
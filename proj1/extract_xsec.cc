@@ -7,6 +7,7 @@
 ////   $root -l extract_xsec.cc
 ////   It will ask for a root file that you have created from splines. Provide full path of the file.
 ////   Then it will ask for directory. Just above that line you can see available directories, copy one of them and paste
+////   Both can also be given directly: $root -l 'extract_xsec.cc("xsec.root", "nu_mu_Ar40")'
 
 
 #include "TFile.h"
@@ -17,6 +18,7 @@
 #include "TString.h"
 #include "TSystem.h"
 #include "TROOT.h"
+#include "TKey.h"
 #include <iostream>
 #include <string>
 #include <vector>
@@ -55,13 +57,15 @@ void setGraphStyle(TGraph* graph, int color, int width, int style) {
     }
 }
 
-void extract_xsec() {
+void extract_xsec(const char* file = "", const char* directory = "") {
     gSystem->Load("libTree");
     gROOT->SetStyle("Plain");
 
-    std::string filePath;
-    std::cout << "Enter the path to the ROOT file: ";
-    std::cin >> filePath;
+    std::string filePath = file;
+    if (filePath.empty()) {
+        std::cout << "Enter the path to the ROOT file: ";
+        std::cin >> filePath;
+    }
 
     //Read input file
     TFile *inputSpline = TFile::Open(filePath.c_str(), "READ");
@@ -88,9 +92,11 @@ void extract_xsec() {
         return;
     }
 
-    std::string dirName;
-    std::cout << "Enter the directory name to analyze (e.g., nu_mu_Ar40): ";
-    std::cin >> dirName;
+    std::string dirName = directory;
+    if (dirName.empty()) {
+        std::cout << "Enter the directory name to analyze (e.g., nu_mu_Ar40): ";
+        std::cin >> dirName;
+    }
 
     TDirectory *dir = (TDirectory*)inputSpline->Get(dirName.c_str());
     if (!dir) {
@@ -1,130 +1,193 @@
 //// To run the program
 //// root -l 'plot_genie_kinematics.cc("../truth.ghep_converted.root")'
+//// To fill the histograms on 8 threads (0 = all cores)
+//// root -l 'plot_genie_kinematics.cc("../truth.ghep_converted.root", 8)'
+//// Every thread reads its own block of entries into its own histograms;
+//// these are added up in block order, so the plots are identical to the
+//// serial run bin for bin.
+//// For a file that is still being appended to, keep a checkpoint:
+//// root -l 'plot_genie_kinematics.cc("../truth.ghep_converted.root", 8, "kinematics_checkpoint.root")'
+//// Every rerun with the same checkpoint only reads the new entries.
+//// Bootstrap statistical errors from 200 Poisson-weighted replicas filled
+//// in the same pass (common/bootstrap.h); variances and covariance matrices
+//// go to kinematics_bootstrap.root
+//// root -l 'plot_genie_kinematics.cc("../truth.ghep_converted.root", 8, "", 200)'
+//// Joint E_nu x Q2 x W x mode x cos(theta_lep) distribution as a sparse
+//// histogram, at most 2 GB, filled on 8 threads and saved to a file
+//// root -l -b
+//// root [0] .L plot_genie_kinematics.cc+
+//// root [1] fill_kinematics_sparse("../truth.ghep_converted.root", 8, "kinematics_sparse.root", 2000)
+//// root [2] project_kinematics_sparse("kinematics_sparse.root", "Enu:Q2")
+//// Axes: Enu, Q2, W, mode (QE, RES, DIS, COH, MEC, other), costh.
+//// Bjorken x recomputed for 50 assumed nucleon masses between 0.80 and
+//// 0.98 GeV, on 8 threads, as a TH2D (x vs mass) in kinematics_mass_scan.root
+//// root -l -b
+//// root [0] .L plot_genie_kinematics.cc+
+//// root [1] scan_nucleon_mass("../truth.ghep_converted.root", 50, 0.80, 0.98, 8)
+//// To measure the scaling from 1 to 8 threads without drawing
+//// root -l -b
+//// root [0] .L plot_genie_kinematics.cc+
+//// root [1] plot_genie_kinematics_scaling("../truth.ghep_converted.root", 8)
 
 #include <TFile.h>
 #include <TTree.h>
 #include <TH1D.h>
+#include <TH2D.h>
+#include <TH3D.h>
+#include <THnSparse.h>
 #include <TCanvas.h>
 #include <TLegend.h>
 #include <TMath.h>
+#include <TROOT.h>
+#include <TStopwatch.h>
+#include <TObjArray.h>
+#include <TObjString.h>
+#include <ROOT/TThreadExecutor.hxx>
+#include <chrono>
 #include <iostream>
 #include <vector>
 
+#include "../common/bootstrap.h"
+#include "../common/converted_reader.h"
+#include "../common/entry_ranges.h"
+#include "../common/hist_engine.h"
+#include "../common/kinematics.h"
+#include "../common/kinematics_batch.h"
+#include "../common/pdg_table.h"
+
 using namespace std;
 
-void plot_genie_kinematics(const char* filename = "genie_output.root") {
+// Everything the histograms are filled from, for one event
+struct KinematicsRow {
+    double nuE;
+    bool IsQE, IsRES, IsDIS, IsMEC, IsCoh;
+    double Elep;          // < 0 if no outgoing e/mu was found
+    double cosLep;        // angle between lepton and neutrino
+    LeptonKinematics k;
+    int mode;             // 0 QE, 1 RES, 2 DIS, 3 COH, 4 MEC, 5 other
+};
 
-    const double mN = 0.939; // nucleon mass [GeV]
+bool compute_kinematics(ConvertedReader& reader, KinematicsRow& row) {
 
-    // --- Open file and get trees
-    TFile *f = TFile::Open(filename);
-    if (!f || f->IsZombie()) {
-        cerr << "Error: cannot open " << filename << endl;
-        return;
-    }
+    const double mN = kNucleonMass; // nucleon mass [GeV]
 
-    TTree *tevt = (TTree*)f->Get("Event");
-    TTree *tpart = (TTree*)f->Get("Particles");
+    row.nuE = reader.nuE;
+    row.IsQE = reader.IsQE; row.IsRES = reader.IsRES; row.IsDIS = reader.IsDIS;
+    row.IsMEC = reader.IsMEC; row.IsCoh = reader.IsCoh;
+    row.mode = row.IsQE ? 0 : row.IsRES ? 1 : row.IsDIS ? 2 : row.IsCoh ? 3 : row.IsMEC ? 4 : 5;
+    const double pnu = sqrt(reader.nuPx*reader.nuPx + reader.nuPy*reader.nuPy + reader.nuPz*reader.nuPz);
 
-    if (!tevt || !tpart) {
-        cerr << "Error: cannot find Event or Particles tree." << endl;
-        return;
+    row.Elep = -1;
+    row.cosLep = 0;
+    row.k = LeptonKinematics();
+    if (reader.HasKinematics()) {
+        // Precomputed by the converter, no particle loop needed. Q2, W, x
+        // and y follow from the stored transfers, so files whose Q2 branch
+        // still holds GENIE's selected kinematics give the same histograms
+        if (abs(reader.lepPdg) == 11 || abs(reader.lepPdg) == 13) row.Elep = reader.lepE;
+        row.k = TransferKinematics(row.nuE, reader.q3, reader.omega, mN);
+        // Lepton momentum is not stored; the angle follows from
+        // q3^2 = pnu^2 + plep^2 - 2 pnu plep cos(theta)
+        double mlep = max(PdgMass(reader.lepPdg), 0.0);
+        double plep = sqrt(max(row.Elep*row.Elep - mlep*mlep, 0.0));
+        row.cosLep = (pnu > 0 && plep > 0) ? (pnu*pnu + plep*plep - row.k.q3*row.k.q3) / (2*pnu*plep) : 1;
+    } else {
+        // Find outgoing lepton (status==1, lepton PDG)
+        double pxl=0, pyl=0, pzl=0;
+        for (int j = 0; j < reader.NParticles(); j++) {
+            if (reader.Status(j) == 1 && (abs(reader.Pdg(j)) == 11 || abs(reader.Pdg(j)) == 13)) {
+                row.Elep = reader.Energy(j);
+                pxl = reader.Px(j); pyl = reader.Py(j); pzl = reader.Pz(j);
+                break;
+            }
+        }
+        // --- compute Q2, q3, omega, x, y
+        if (row.Elep >= 0) {
+            row.k = ComputeLeptonKinematics(row.nuE, reader.nuPx, reader.nuPy, reader.nuPz,
+                                            row.Elep, pxl, pyl, pzl, mN);
+            double plep = sqrt(pxl*pxl + pyl*pyl + pzl*pzl);
+            row.cosLep = (pnu > 0 && plep > 0)
+                ? (reader.nuPx*pxl + reader.nuPy*pyl + reader.nuPz*pzl) / (pnu*plep) : 1;
+        }
     }
+    return true;
+}
 
-    // --- Event tree variables
-    int nupdg;
-    double nuE, nuPx, nuPy, nuPz;
-    bool IsQE, IsRES, IsDIS, IsMEC, IsCoh;
-
-    tevt->SetBranchAddress("nupdg", &nupdg);
-    tevt->SetBranchAddress("nuE", &nuE);
-    tevt->SetBranchAddress("nuPx", &nuPx);
-    tevt->SetBranchAddress("nuPy", &nuPy);
-    tevt->SetBranchAddress("nuPz", &nuPz);
-    tevt->SetBranchAddress("IsQE", &IsQE);
-    tevt->SetBranchAddress("IsRES", &IsRES);
-    tevt->SetBranchAddress("IsDIS", &IsDIS);
-    tevt->SetBranchAddress("IsMEC", &IsMEC);
-    tevt->SetBranchAddress("IsCoh", &IsCoh);
-
-    // --- Particle tree variables
-    vector<int>   *status = nullptr, *pdg = nullptr;
-    vector<double>* energy = nullptr, *px = nullptr, *py = nullptr, *pz = nullptr;
-    tpart->SetBranchAddress("status", &status);
-    tpart->SetBranchAddress("pdg", &pdg);
-    tpart->SetBranchAddress("energy", &energy);
-    tpart->SetBranchAddress("px", &px);
-    tpart->SetBranchAddress("py", &py);
-    tpart->SetBranchAddress("pz", &pz);
+// The 12 histograms, all filled in one pass by the engine
+struct KinematicsHists {
+    TH1D *hE_nu_total, *hE_nu_qe, *hE_nu_res, *hE_nu_dis, *hE_nu_mec, *hE_nu_coh;
+    TH1D *hE_lep, *hQ2, *hq3, *hw, *hx, *hy;
+};
 
+KinematicsHists book_kinematics(HistEngine<KinematicsRow>& engine) {
     // --- Histograms
     const int nbins = 50;
     const double Emax = 10.0;
 
-    auto makeHist = [&](const char* name, const char* title){
-        return new TH1D(name, title, nbins, 0, Emax);
-    };
-
-    TH1D *hE_nu_total = makeHist("hE_nu_total", "Neutrino Energy;E_{#nu} [GeV];Events");
-    TH1D *hE_nu_qe  = makeHist("hE_nu_qe",  "QE;E_{#nu} [GeV];Events");
-    TH1D *hE_nu_res = makeHist("hE_nu_res", "RES;E_{#nu} [GeV];Events");
-    TH1D *hE_nu_dis = makeHist("hE_nu_dis", "DIS;E_{#nu} [GeV];Events");
-    TH1D *hE_nu_mec = makeHist("hE_nu_mec", "MEC;E_{#nu} [GeV];Events");
-    TH1D *hE_nu_coh = makeHist("hE_nu_coh", "COH;E_{#nu} [GeV];Events");
-
-    TH1D *hE_lep = makeHist("hE_lep", "Outgoing Lepton Energy;E_{lep} [GeV];Events");
-    TH1D *hQ2 = new TH1D("hQ2", "Four-Momentum Transfer;Q^{2} [GeV^{2}];Events", 50, 0, 5);
-    TH1D *hq3 = new TH1D("hq3", "Three-Momentum Transfer;|q| [GeV];Events", 50, 0, 5);
-    TH1D *hw = new TH1D("hw", "Energy Transfer;#omega [GeV];Events", 50, 0, 5);
-    TH1D *hx = new TH1D("hx", "Bjorken x;x;Events", 50, 0, 1);
-    TH1D *hy = new TH1D("hy", "Bjorken y;y;Events", 50, 0, 1);
-
-    // --- Event loop
-    Long64_t N = tevt->GetEntries();
-    for (Long64_t i = 0; i < N; i++) {
-
-        tevt->GetEntry(i);
-        tpart->GetEntry(i);
-
-        hE_nu_total->Fill(nuE);
-        if (IsQE)  hE_nu_qe->Fill(nuE);
-        if (IsRES) hE_nu_res->Fill(nuE);
-        if (IsDIS) hE_nu_dis->Fill(nuE);
-        if (IsMEC) hE_nu_mec->Fill(nuE);
-        if (IsCoh) hE_nu_coh->Fill(nuE);
+    typedef const KinematicsRow& R;
+    auto nuE = [](R r){ return r.nuE; };
+    auto hasLepton = [](R r){ return r.Elep >= 0; };
 
-        // Find outgoing lepton (status==1, lepton PDG)
-        double Elep = -1, pxl=0, pyl=0, pzl=0;
-        for (size_t j = 0; j < pdg->size(); j++) {
-            if ((*status)[j] == 1 && (abs((*pdg)[j]) == 11 || abs((*pdg)[j]) == 13)) {
-                Elep = (*energy)[j];
-                pxl = (*px)[j]; pyl = (*py)[j]; pzl = (*pz)[j];
-                break;
-            }
-        }
-        if (Elep < 0) continue; // no outgoing lepton found
+    KinematicsHists h;
+    h.hE_nu_total = engine.Book1D("hE_nu_total", "Neutrino Energy;E_{#nu} [GeV];Events", nbins, 0, Emax, nuE);
+    h.hE_nu_qe  = engine.Book1D("hE_nu_qe",  "QE;E_{#nu} [GeV];Events",  nbins, 0, Emax, nuE, nullptr, [](R r){ return r.IsQE; });
+    h.hE_nu_res = engine.Book1D("hE_nu_res", "RES;E_{#nu} [GeV];Events", nbins, 0, Emax, nuE, nullptr, [](R r){ return r.IsRES; });
+    h.hE_nu_dis = engine.Book1D("hE_nu_dis", "DIS;E_{#nu} [GeV];Events", nbins, 0, Emax, nuE, nullptr, [](R r){ return r.IsDIS; });
+    h.hE_nu_mec = engine.Book1D("hE_nu_mec", "MEC;E_{#nu} [GeV];Events", nbins, 0, Emax, nuE, nullptr, [](R r){ return r.IsMEC; });
+    h.hE_nu_coh = engine.Book1D("hE_nu_coh", "COH;E_{#nu} [GeV];Events", nbins, 0, Emax, nuE, nullptr, [](R r){ return r.IsCoh; });
 
-        hE_lep->Fill(Elep);
+    // Lepton quantities only for events with an outgoing e/mu
+    h.hE_lep = engine.Book1D("hE_lep", "Outgoing Lepton Energy;E_{lep} [GeV];Events", nbins, 0, Emax,
+                             [](R r){ return r.Elep; }, nullptr, hasLepton);
+    h.hQ2 = engine.Book1D("hQ2", "Four-Momentum Transfer;Q^{2} [GeV^{2}];Events", 50, 0, 5,
+                          [](R r){ return r.k.Q2; }, nullptr, hasLepton);
+    h.hq3 = engine.Book1D("hq3", "Three-Momentum Transfer;|q| [GeV];Events", 50, 0, 5,
+                          [](R r){ return r.k.q3; }, nullptr, hasLepton);
+    h.hw = engine.Book1D("hw", "Energy Transfer;#omega [GeV];Events", 50, 0, 5,
+                         [](R r){ return r.k.omega; }, nullptr, hasLepton);
+    h.hx = engine.Book1D("hx", "Bjorken x;x;Events", 50, 0, 1,
+                         [](R r){ return r.k.x; }, nullptr, hasLepton);
+    h.hy = engine.Book1D("hy", "Bjorken y;y;Events", 50, 0, 1,
+                         [](R r){ return r.k.y; }, nullptr, hasLepton);
+    return h;
+}
 
-        // --- compute Q2, q3, omega, x, y
-        double qx = nuPx - pxl;
-        double qy = nuPy - pyl;
-        double qz = nuPz - pzl;
-        double q3 = sqrt(qx*qx + qy*qy + qz*qz);
-        double omega = nuE - Elep;
-        double Q2 = q3*q3 - omega*omega; // Q^2 = |q|^2 - ω^2
-        if (Q2 < 0) Q2 = 0;
-
-        double y = omega / nuE;
-        double x = (2*mN*omega > 0) ? (Q2 / (2*mN*omega)) : 0;
-
-        hQ2->Fill(Q2);
-        hq3->Fill(q3);
-        hw->Fill(omega);
-        hx->Fill(x);
-        hy->Fill(y);
+void plot_genie_kinematics(const char* filename = "genie_output.root", int nthreads = 1,
+                           const char* checkpoint = "", int nreplicas = 0) {
+
+    // --- Open file; particles are only read for files converted without
+    // the derived kinematics branches
+    HistEngine<KinematicsRow> engine(compute_kinematics);
+    KinematicsHists h = book_kinematics(engine);
+    TH1D* all[] = {h.hE_nu_total, h.hE_nu_qe, h.hE_nu_res, h.hE_nu_dis, h.hE_nu_mec, h.hE_nu_coh,
+                   h.hE_lep, h.hQ2, h.hq3, h.hw, h.hx, h.hy};
+    const int nhists = sizeof(all) / sizeof(all[0]);
+    vector<TH2D*> replicas;
+    for (int k = 0; k < nhists && nreplicas > 0; k++) replicas.push_back(engine.BookBootstrap(all[k], nreplicas));
+    const int mode = ConvertedReader::kParticlesIfNoKinematics;
+    bool ok = checkpoint[0] ? engine.RunIncremental(filename, checkpoint, mode, nthreads)
+                            : engine.Run(filename, mode, nthreads);
+    if (!ok) return;
+
+    // Bootstrap errors replace the default sqrt(N) ones
+    if (nreplicas > 0) {
+        TFile out("kinematics_bootstrap.root", "RECREATE");
+        for (int k = 0; k < nhists; k++) {
+            TH1D* var = BootstrapVariance(replicas[k], Form("%s_var", all[k]->GetName()));
+            TH2D* cov = BootstrapCovariance(replicas[k], Form("%s_cov", all[k]->GetName()));
+            SetBootstrapErrors(all[k], var);
+            out.WriteTObject(replicas[k]);
+            out.WriteTObject(var);
+            out.WriteTObject(cov);
+        }
+        out.Close();
+        cout << "Bootstrap variances and covariances (" << nreplicas << " replicas) saved to kinematics_bootstrap.root" << endl;
     }
 
+    TH1D *hE_nu_total = h.hE_nu_total, *hE_nu_qe = h.hE_nu_qe, *hE_nu_res = h.hE_nu_res;
+    TH1D *hE_nu_dis = h.hE_nu_dis, *hE_nu_mec = h.hE_nu_mec, *hE_nu_coh = h.hE_nu_coh;
+    TH1D *hE_lep = h.hE_lep, *hQ2 = h.hQ2, *hq3 = h.hq3, *hw = h.hw, *hx = h.hx, *hy = h.hy;
+
     // --- Draw
     TCanvas *c1 = new TCanvas("c1", "Neutrino Energy by Interaction Type", 800, 600);
     hE_nu_total->SetLineColor(kBlack);
@@ -189,7 +252,246 @@ void plot_genie_kinematics(const char* filename = "genie_output.root") {
     c2->SaveAs("kinematics.png");
 
     cout << "✅ Plots saved: neutrino_energy_types.png, kinematics.png" << endl;
+}
+
+
+// Time the filling with 1, 2, 4, ... up to maxThreads threads and check that
+// every run gives the same histograms as the serial one
+void plot_genie_kinematics_scaling(const char* filename = "genie_output.root", int maxThreads = 0) {
+
+    maxThreads = ResolveThreadCount(maxThreads);
+    vector<int> counts;
+    for (int n = 1; n < maxThreads; n *= 2) counts.push_back(n);
+    counts.push_back(maxThreads);
 
+    HistEngine<KinematicsRow> engine(compute_kinematics);
+    KinematicsHists h = book_kinematics(engine);
+
+    vector<double> serial;
+    double serialTime = 0;
+    printf("%8s %10s %12s %8s %10s\n", "threads", "time[s]", "events/s", "speedup", "identical");
+    for (size_t c = 0; c < counts.size(); c++) {
+        engine.Reset();
+        TStopwatch timer;
+        if (!engine.Run(filename, ConvertedReader::kParticlesIfNoKinematics, counts[c])) return;
+        double t = timer.RealTime();
+
+        vector<double> bins;
+        for (size_t j = 0; j < engine.NHists(); j++)
+            for (int bin = 0; bin < engine.Hist(j)->GetNcells(); bin++)
+                bins.push_back(engine.Hist(j)->GetBinContent(bin));
+        if (c == 0) {
+            serial = bins;
+            serialTime = t;
+        }
+        double nevents = h.hE_nu_total->GetEntries();
+        printf("%8d %10.3f %12.0f %8.2f %10s\n", counts[c], t, t > 0 ? nevents/t : 0,
+               t > 0 ? serialTime/t : 0, bins == serial ? "yes" : "NO");
+    }
+}
+
+// Joint distribution of the kinematics of all events with an outgoing e/mu,
+// as a sparse histogram of at most capMB, saved as hKinematics in output
+void fill_kinematics_sparse(const char* filename = "genie_output.root", int nthreads = 1,
+                            const char* output = "kinematics_sparse.root", double capMB = 2000) {
+
+    typedef const KinematicsRow& R;
+    HistEngine<KinematicsRow> engine(compute_kinematics);
+    engine.SetSparseMemoryCap(capMB);
+    THnSparseD* h = engine.BookSparse("hKinematics", "Lepton kinematics", {
+            {"Enu",   "E_{#nu} [GeV]",         200, 0, 10, [](R r){ return r.nuE; }},
+            {"Q2",    "Q^{2} [GeV^{2}]",       100, 0, 5,  [](R r){ return r.k.Q2; }},
+            {"W",     "W [GeV]",               100, 0, 5,  [](R r){ return r.k.W; }},
+            {"mode",  "interaction mode",        6, 0, 6,  [](R r){ return r.mode + 0.5; }},
+            {"costh", "cos#theta_{lep}",       100, -1, 1, [](R r){ return r.cosLep; }},
+        }, nullptr, [](R r){ return r.Elep >= 0; });
+    const char* modes[] = {"QE", "RES", "DIS", "COH", "MEC", "other"};
+    for (int m = 0; m < 6; m++) h->GetAxis(3)->SetBinLabel(m + 1, modes[m]);
+
+    TStopwatch timer;
+    bool ok = engine.Run(filename, ConvertedReader::kParticlesIfNoKinematics, nthreads);
+    cout << "Filled " << h->GetNbins() << " bins (" << HistEngine<KinematicsRow>::SparseMB(h)
+         << " MB) from " << engine.GetAccepted() << " events in " << timer.RealTime() << " s" << endl;
+    if (ok) {
+        TFile out(output, "RECREATE");
+        out.WriteTObject(h);
+        out.Close();
+        cout << "Saved " << output << endl;
+    }
+    delete h;
+}
+
+// Projection of the saved sparse histogram onto 1 to 3 axes given by name,
+// e.g. "Enu", "Enu:Q2" or "Q2:W:mode" (x:y:z), drawn and saved as png.
+// More axes give a smaller THnSparse, written next to the input.
+void project_kinematics_sparse(const char* sparseFile = "kinematics_sparse.root", const char* axes = "Enu:Q2") {
+
+    TFile* f = TFile::Open(sparseFile, "READ");
+    gROOT->cd();
+    if (!f || f->IsZombie()) {
+        cerr << "Error: cannot open " << sparseFile << endl;
+        return;
+    }
+    THnSparse* h = f->Get<THnSparse>("hKinematics");
+    if (!h) {
+        cerr << "Error: no hKinematics in " << sparseFile << endl;
+        f->Close();
+        return;
+    }
+
+    vector<int> dims;
+    TObjArray* names = TString(axes).Tokenize(":");
+    for (int k = 0; k < names->GetEntries(); k++) {
+        TString name = ((TObjString*)names->At(k))->GetString();
+        int d = 0;
+        while (d < h->GetNdimensions() && name != h->GetAxis(d)->GetName()) d++;
+        if (d == h->GetNdimensions()) {
+            cerr << "Error: no axis " << name << " (have Enu, Q2, W, mode, costh)" << endl;
+            delete names;
+            f->Close();
+            return;
+        }
+        dims.push_back(d);
+    }
+    delete names;
+
+    TString tag = TString(axes).ReplaceAll(":", "_");
+    TCanvas* c = new TCanvas("c_sparse", axes, 800, 600);
+    if (dims.size() == 1) {
+        h->Projection(dims[0])->Draw("HIST");
+    } else if (dims.size() == 2) {
+        h->Projection(dims[1], dims[0])->Draw("COLZ");
+    } else if (dims.size() == 3) {
+        h->Projection(dims[0], dims[1], dims[2])->Draw("BOX2");
+    } else {
+        THnSparse* p = h->Projection(dims.size(), dims.data());
+        TFile out("kinematics_sparse_" + tag + ".root", "RECREATE");
+        out.WriteTObject(p);
+        out.Close();
+        cout << "Saved kinematics_sparse_" << tag << ".root" << endl;
+        delete p;
+    }
+    if (dims.size() <= 3) {
+        c->SaveAs("kinematics_sparse_" + tag + ".png");
+    }
+    delete h;
     f->Close();
 }
 
+// Events per block of scan_nucleon_mass: the 13 arrays of a KinematicsBatch
+// (about 420 kB) stay in cache while the kernel runs once per mass
+const int kScanBlock = 4096;
+
+// Outgoing e/mu of the current entry as in compute_kinematics; false if none
+bool find_scan_lepton(const ConvertedReader& reader, int& j) {
+    if (reader.HasKinematics()) {
+        j = reader.lepIndex;
+        return j >= 0 && (abs(reader.lepPdg) == 11 || abs(reader.lepPdg) == 13);
+    }
+    for (j = 0; j < reader.NParticles(); j++)
+        if (reader.Status(j) == 1 && (abs(reader.Pdg(j)) == 11 || abs(reader.Pdg(j)) == 13)) return true;
+    return false;
+}
+
+// Bjorken x of all events with an outgoing e/mu, recomputed for nmass
+// nucleon masses from mmin to mmax [GeV] and saved as the TH2D hx_mass
+// (x vs mass) in output. The file is read once: events are collected in
+// blocks of kScanBlock into a KinematicsBatch, and the batched kernel
+// (common/kinematics_batch.h) runs over each block once per mass. The x
+// bins are counted in plain arrays; a TH2D::Fill per event and mass would
+// cost more than the kernel itself. The bin numbers of a block are
+// computed in one (vectorized) loop and counted into 4 interleaved copies,
+// so consecutive events in the same bin do not wait on each other.
+void scan_nucleon_mass(const char* filename = "genie_output.root", int nmass = 50,
+                       double mmin = 0.80, double mmax = 0.98, int nthreads = 1,
+                       const char* output = "kinematics_mass_scan.root") {
+
+    const int nx = 100; // x bins over [0, 1), plus underflow (unused) and overflow
+    const int nrow = nx + 2;
+    if (nmass < 1) nmass = 1;
+    const double dm = nmass > 1 ? (mmax - mmin) / (nmass - 1) : 0;
+    const double halfBin = nmass > 1 ? 0.5*dm : 0.005; // mass k at the centre of bin k+1
+
+    Long64_t nentries;
+    {
+        ConvertedReader probe(filename, ConvertedReader::kNoParticles);
+        if (!probe.IsOpen()) return;
+        nentries = probe.GetEntries();
+    }
+    vector<EntryRange> blocks = SplitEntries(nentries, ResolveThreadCount(nthreads));
+    vector<vector<double>> counts(blocks.size(), vector<double>((size_t)nrow * nmass, 0));
+    vector<Long64_t> nused(blocks.size(), 0);
+    vector<double> kernelSeconds(blocks.size(), 0);
+
+    TStopwatch timer;
+    ROOT::EnableThreadSafety();
+    ROOT::TThreadExecutor pool(max<size_t>(blocks.size(), 1));
+    pool.Foreach([&](unsigned int t) {
+            ConvertedReader reader(filename, ConvertedReader::kParticles);
+            if (!reader.IsOpen()) return;
+            vector<double>& c = counts[t];
+            KinematicsBatch b;
+            b.Resize(kScanBlock);
+            vector<int> bins(kScanBlock);
+            vector<unsigned> part(4 * nrow, 0);
+            size_t n = 0;
+            auto runBlock = [&]() {
+                b.Resize(n);
+                auto t0 = chrono::steady_clock::now();
+                for (int k = 0; k < nmass; k++) {
+                    ComputeLeptonKinematicsBatch(b, mmin + k*dm);
+                    // x >= 0 always (Q2 >= 0, x = 0 where omega <= 0)
+                    for (size_t i = 0; i < n; i++) bins[i] = b.x[i] >= 1 ? nx + 1 : 1 + (int)(b.x[i] * nx);
+                    size_t i = 0;
+                    for (; i + 4 <= n; i += 4) {
+                        part[bins[i]]++;
+                        part[nrow + bins[i + 1]]++;
+                        part[2*nrow + bins[i + 2]]++;
+                        part[3*nrow + bins[i + 3]]++;
+                    }
+                    for (; i < n; i++) part[bins[i]]++;
+                    double* row = &c[(size_t)k * nrow];
+                    for (int q = 0; q < nrow; q++) {
+                        row[q] += part[q] + part[nrow + q] + part[2*nrow + q] + part[3*nrow + q];
+                        part[q] = part[nrow + q] = part[2*nrow + q] = part[3*nrow + q] = 0;
+                    }
+                }
+                kernelSeconds[t] += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+                nused[t] += n;
+                n = 0;
+                b.Resize(kScanBlock);
+            };
+            for (Long64_t e = blocks[t].begin; e < blocks[t].end; e++) {
+                reader.GetEntry(e);
+                int j;
+                if (!find_scan_lepton(reader, j)) continue;
+                b.nuE[n] = reader.nuE; b.nuPx[n] = reader.nuPx; b.nuPy[n] = reader.nuPy; b.nuPz[n] = reader.nuPz;
+                b.lepE[n] = reader.Energy(j); b.lepPx[n] = reader.Px(j); b.lepPy[n] = reader.Py(j); b.lepPz[n] = reader.Pz(j);
+                if (++n == kScanBlock) runBlock();
+            }
+            if (n > 0) runBlock();
+        }, ROOT::TSeqU(blocks.size()));
+
+    // Counts are integers, so the sum does not depend on the thread count
+    TH2D* h = new TH2D("hx_mass", "Bjorken x vs nucleon mass;x;m_{N} [GeV];Events",
+                       nx, 0, 1, nmass, mmin - halfBin, mmin + (nmass - 1)*dm + halfBin);
+    Long64_t used = 0;
+    double kernel = 0;
+    for (size_t t = 0; t < blocks.size(); t++) {
+        used += nused[t];
+        kernel += kernelSeconds[t];
+        for (int k = 0; k < nmass; k++)
+            for (int bin = 0; bin < nrow; bin++)
+                h->SetBinContent(bin, k + 1, h->GetBinContent(bin, k + 1) + counts[t][(size_t)k * nrow + bin]);
+    }
+    h->SetEntries((double)used * nmass);
+
+    cout << "Scanned " << nmass << " nucleon masses over " << used << " events in " << timer.RealTime()
+         << " s; kernel and binning " << (used > 0 ? 1e9 * kernel / ((double)used * nmass) : 0)
+         << " ns per event and mass (summed over threads)" << endl;
+    TFile out(output, "RECREATE");
+    out.WriteTObject(h);
+    out.Close();
+    cout << "Saved " << output << endl;
+    delete h;
+}
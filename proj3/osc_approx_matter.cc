@@ -1,5 +1,21 @@
 // To run the program
 // root -l 'osc_approx_matter.cc("../truth.ghep_converted.root")'
+// Besides the two-flavour approximations it draws the exact three-flavour
+// result in constant-density matter (common/oscillation.h), for neutrinos
+// and antineutrinos according to nupdg. The exact probabilities are
+// tabulated once per run and interpolated per event.
+// With cacheWeights the per-event probabilities are kept in
+// <file>_oscw.root (common/osc_weights.h) and reused by later runs with the
+// same parameters:
+// root -l 'osc_approx_matter.cc("../truth.ghep_converted.root", 810, 2.8, true, true)'
+// With a flux file the events are weighted with flux x xsection x POT
+// (common/flux_weights.h), so without normalisation the histograms are
+// absolute rates per target nucleus:
+// root -l 'osc_approx_matter.cc("../truth.ghep_converted.root", 810, 2.8, false, false, "../FHC_Flux_NOvA_ND_2017.root", 1e21)'
+// With a number of bootstrap replicas the statistical errors of the four
+// spectra come from Poisson-weighted replicas filled in the same loop
+// (common/bootstrap.h); variances and covariances go to osc_bootstrap.root
+// root -l 'osc_approx_matter.cc("../truth.ghep_converted.root", 810, 2.8, true, false, "", 1e21, 200)'
 
 
 #include <TFile.h>
@@ -11,6 +27,12 @@
 #include <TMath.h>
 #include <iostream>
 
+#include "../common/converted_reader.h"
+#include "../common/oscillation.h"
+#include "../common/osc_weights.h"
+#include "../common/flux_weights.h"
+#include "../common/bootstrap.h"
+
 using namespace std;
 
 // --- Constants ---
@@ -103,23 +125,29 @@ double P_mu_to_mu_matter_approx(double E, double Lkm, double rho, double Ye,
 void osc_approx_matter(const char* filename = "genie_output.root",
                        double baseline_km = L_default,
                        double density = rho_default,
-                       bool normalize = true) {
+                       bool normalize = true,
+                       bool cacheWeights = false,
+                       const char* fluxFile = "",
+                       double pot = 1e21,
+                       int nreplicas = 0) {
 
     gStyle->SetOptStat(0);
 
-    // Open file and Event tree
-    TFile *f = TFile::Open(filename);
-    if (!f || f->IsZombie()) { cout << "Cannot open " << filename << endl; return; }
-    TTree *t = (TTree*)f->Get("Event");
-    if (!t) { cout << "Event tree not found." << endl; f->Close(); return; }
-
-    double nuE = 0;
-    int nupdg = 14;
-    double xsec = 1.0;
+    // Open file (TTree or RNTuple), only the event-level fields are needed
+    ConvertedReader reader(filename, ConvertedReader::kNoParticles);
+    if (!reader.IsOpen()) return;
 
-    t->SetBranchAddress("nuE", &nuE);
-    if (t->GetBranch("nupdg")) t->SetBranchAddress("nupdg", &nupdg);
-    if (t->GetBranch("xsection")) t->SetBranchAddress("xsection", &xsec);
+    // Flux x xsection x POT weights instead of xsection alone
+    FluxWeighter flux;
+    if (fluxFile[0]) {
+        if (!flux.Load(fluxFile)) return;
+        flux.SetExposure(pot);
+        // a skimmed file is normalised to the events generated before the skim
+        flux.SetSample(reader.GetGeneratedEntries(), flux.EnergyLow(), flux.EnergyHigh());
+        if (reader.IsSkimmed())
+            cout << "Skimmed input: " << reader.GetEntries() << " of " << reader.GetGeneratedEntries()
+                 << " generated events kept, the flat-sample check is skipped" << endl;
+    }
 
     // Histograms
     int nbins = 100;
@@ -127,25 +155,114 @@ void osc_approx_matter(const char* filename = "genie_output.root",
     TH1D *h_no = new TH1D("h_no", ";E_{#nu} [GeV];Arb", nbins, Emin, Emax);
     TH1D *h_vac = new TH1D("h_vac", ";E_{#nu} [GeV];Arb", nbins, Emin, Emax);
     TH1D *h_mat = new TH1D("h_mat", ";E_{#nu} [GeV];Arb", nbins, Emin, Emax);
+    TH1D *h_exact = new TH1D("h_exact", ";E_{#nu} [GeV];Arb", nbins, Emin, Emax);
 
-    Long64_t N = t->GetEntries();
+    // Bootstrap replicas, one row of bins per replica
+    TH1D* spectra[4] = {h_no, h_vac, h_mat, h_exact};
+    TH2D* replicas[4] = {};
+    vector<double> poisson(max(nreplicas, 0));
+    for (int k = 0; k < 4 && nreplicas > 0; k++) replicas[k] = MakeReplicaHist(spectra[k], nreplicas);
+
+    // True energies of all events, for the flat-sample check of the flux
+    // normalisation; the events kept by a skim need not be flat
+    TH1D *h_sample = nullptr;
+    if (flux.IsLoaded() && !reader.IsSkimmed())
+        h_sample = new TH1D("h_flux_sample", ";E_{#nu} [GeV];Events", kSampleCheckBins,
+                            flux.EnergyLow(), flux.EnergyHigh());
+
+    Long64_t N = reader.GetEntries();
     cout << "Entries: " << N << endl;
 
-    for (Long64_t i = 0; i < N; ++i) {
-        t->GetEntry(i);
-        if (nuE <= 0) continue;
-        if (abs(nupdg) != 14) continue; // only muon neutrinos considered here
+    // Stored weights: each column is keyed by the parameters it depends on
+    const OscParams params = {th12, th13, th23, dm21, dm31, deltaCP};
+    const string keyVac = OscWeightKey("Pvac", filename, {baseline_km, th13, th23, dm31});
+    const string keyMat = OscWeightKey("Pmat", filename, {baseline_km, density, Ye, th13, th23, dm31});
+    const string keyExact = ExactWeightKey(filename, params, baseline_km, density, Ye);
+    OscWeightFile store(filename);
+    vector<double> wvac, wmat, wexact;
+    const bool haveVac = cacheWeights && store.Read("Pvac", keyVac, N, wvac);
+    const bool haveMat = cacheWeights && store.Read("Pmat", keyMat, N, wmat);
+    const bool haveExact = cacheWeights && store.Read("Pexact", keyExact, N, wexact);
+    if (cacheWeights) {
+        wvac.resize(N);
+        wmat.resize(N);
+        wexact.resize(N);
+    }
 
-        double w = xsec;
-        h_no->Fill(nuE, w);
+    // Exact three-flavour probabilities, one table each for nu and nubar
+    OscTable table[2];
+    if (!haveExact) {
+        table[0].Build(params, baseline_km, density, Ye, false);
+        table[1].Build(params, baseline_km, density, Ye, true);
+    }
 
-        // vacuum approx (dominant terms)
-        double Pvac = P_mu_to_mu_vac(nuE, baseline_km, th23, th13, dm31);
-        h_vac->Fill(nuE, w * Pvac);
+    for (Long64_t i = 0; i < N; ++i) {
+        reader.GetEntry(i);
+        const double nuE = reader.nuE;
+        if (h_sample) h_sample->Fill(nuE);
+        // only muon neutrinos considered here; stored columns cover every entry
+        const bool used = nuE > 0 && abs(reader.nupdg) == 14;
+        if (!used && !cacheWeights) continue;
 
+        // vacuum approx (dominant terms)
+        double Pvac = haveVac ? wvac[i] : P_mu_to_mu_vac(nuE, baseline_km, th23, th13, dm31);
         // matter approx
-        double Pmat = P_mu_to_mu_matter_approx(nuE, baseline_km, density, Ye, th23, dm31, th13);
+        double Pmat = haveMat ? wmat[i] : P_mu_to_mu_matter_approx(nuE, baseline_km, density, Ye, th23, dm31, th13);
+        // exact, three flavours
+        double Pexact = haveExact ? wexact[i] : ExactSurvivalWeight(table, reader.nupdg, nuE);
+        if (cacheWeights) {
+            wvac[i] = Pvac;
+            wmat[i] = Pmat;
+            wexact[i] = Pexact;
+        }
+        if (!used) continue;
+
+        double w = flux.IsLoaded() ? flux.Weight(reader.nupdg, nuE, reader.xsection) : reader.xsection;
+        h_no->Fill(nuE, w);
+        h_vac->Fill(nuE, w * Pvac);
         h_mat->Fill(nuE, w * Pmat);
+        h_exact->Fill(nuE, w * Pexact);
+        if (nreplicas > 0) {
+            PoissonReplicaWeights(i, 0, nreplicas, poisson.data());
+            FillReplicas(replicas[0], nuE, w, poisson.data());
+            FillReplicas(replicas[1], nuE, w * Pvac, poisson.data());
+            FillReplicas(replicas[2], nuE, w * Pmat, poisson.data());
+            FillReplicas(replicas[3], nuE, w * Pexact, poisson.data());
+        }
+    }
+
+    if (cacheWeights) {
+        cout << "Oscillation weights in " << store.Path() << ":"
+             << (haveVac ? " Pvac reused" : " Pvac computed")
+             << (haveMat ? ", Pmat reused" : ", Pmat computed")
+             << (haveExact ? ", Pexact reused" : ", Pexact computed") << endl;
+        if (!haveVac) store.Write("Pvac", keyVac, Form("vacuum approx P(mumu), L=%g km", baseline_km), wvac);
+        if (!haveMat) store.Write("Pmat", keyMat, Form("matter approx P(mumu), L=%g km, rho=%g g/cm3", baseline_km, density), wmat);
+        if (!haveExact) store.Write("Pexact", keyExact, Form("exact survival, L=%g km, rho=%g g/cm3", baseline_km, density), wexact);
+    }
+
+    // A sample that is not flat cannot be normalised to absolute rates
+    if (h_sample && !flux.CheckFlatSample(h_sample)) return;
+    if (flux.IsLoaded())
+        cout << "Predicted events per target for " << pot << " POT: " << h_no->Integral()
+             << " unoscillated, " << h_exact->Integral() << " oscillated (exact)" << endl;
+
+    // Bootstrap errors replace the Sumw2 ones, before any normalisation
+    if (nreplicas > 0) {
+        TFile out("osc_bootstrap.root", "RECREATE");
+        for (int k = 0; k < 4; k++) {
+            replicas[k]->ResetStats();
+            TH1D* var = BootstrapVariance(replicas[k], Form("%s_var", spectra[k]->GetName()));
+            TH2D* cov = BootstrapCovariance(replicas[k], Form("%s_cov", spectra[k]->GetName()));
+            SetBootstrapErrors(spectra[k], var);
+            cout << spectra[k]->GetName() << ": integral " << spectra[k]->Integral() << " +- "
+                 << sqrt(cov->Integral()) << " (bootstrap, " << nreplicas << " replicas)" << endl;
+            out.WriteTObject(replicas[k]);
+            out.WriteTObject(var);
+            out.WriteTObject(cov);
+        }
+        out.Close();
+        cout << "Saved osc_bootstrap.root" << endl;
     }
 
     // Normalize if requested
@@ -153,27 +270,29 @@ void osc_approx_matter(const char* filename = "genie_output.root",
         if (h_no->Integral() > 0) h_no->Scale(1.0 / h_no->Integral());
         if (h_vac->Integral() > 0) h_vac->Scale(1.0 / h_vac->Integral());
         if (h_mat->Integral() > 0) h_mat->Scale(1.0 / h_mat->Integral());
+        if (h_exact->Integral() > 0) h_exact->Scale(1.0 / h_exact->Integral());
     }
 
     // Draw
     h_no->SetLineColor(kBlack); h_no->SetLineWidth(3);
     h_vac->SetLineColor(kBlue); h_vac->SetLineWidth(3); h_vac->SetLineStyle(2);
     h_mat->SetLineColor(kMagenta); h_mat->SetLineWidth(3); h_mat->SetLineStyle(3);
+    h_exact->SetLineColor(kRed); h_exact->SetLineWidth(2);
 
     TCanvas *c = new TCanvas("c", "", 900, 700);
     h_no->Draw("HIST");
     h_vac->Draw("HIST SAME");
     h_mat->Draw("HIST SAME");
+    h_exact->Draw("HIST SAME");
 
     TLegend *leg = new TLegend(0.58,0.65,0.88,0.88);
     leg->AddEntry(h_no, "Unoscillated", "l");
     leg->AddEntry(h_vac, "Oscillated (vacuum approx)", "l");
     leg->AddEntry(h_mat, "Oscillated (matter approx)", "l");
+    leg->AddEntry(h_exact, "Oscillated (3#nu, matter, exact)", "l");
     leg->Draw();
 
     c->SetGrid();
     c->SaveAs("osc_approx_compare.png");
     cout << "Saved osc_approx_compare.png" << endl;
-
-    f->Close();
 }
@@ -0,0 +1,186 @@
+// Oscillation parameter scan over sin^2(theta23) x dm31 x deltaCP
+// root -l -b -q 'osc_grid_scan.cc+("../truth.ghep_converted.root", 40, 40, 36, 0)'
+// The arguments after the file are the number of grid points along
+// sin^2(theta23), dm31 and deltaCP, and the number of threads (0 = all cores).
+// The events are read once and reduced to weights in a few energy sub-bins
+// per analysis bin, separately for neutrinos and antineutrinos; every grid
+// point then only recomputes the exact three-flavour probabilities
+// (common/oscillation.h) once per sub-bin, shared by the nu_e and nu_mu
+// weights in it. The prediction has two samples, nu_mu-like and nu_e-like:
+// the e and mu weights each contribute to both with P(a -> mu) and
+// P(a -> e), so nu_mu -> nu_e appearance (the deltaCP-sensitive channel)
+// enters the nu_e sample with the nu_mu flux.
+// Appeared events are weighted with the cross section of the parent
+// flavour, assuming sigma(nu_e) = sigma(nu_mu) at the same energy. The
+// reference spectrum is the prediction at the nominal parameters (Asimov
+// data) scaled to `exposure` unoscillated events.
+// Output (osc_grid_scan.root):
+//   h_ref_mu, h_ref_e     reference spectra of the two samples
+//   h_chi2, h_m2lnL       Pearson chi2 and Poisson -2 ln L as TH3 (s23 x dm31 x dCP)
+//   h_chi2_s23_dm31       Delta chi2 minimised over deltaCP, as TH2
+// Compile it (the trailing +) or use mctool: the scan loop is too slow in cling.
+
+#include <TFile.h>
+#include <TH1D.h>
+#include <TH2D.h>
+#include <TH3D.h>
+#include <TStopwatch.h>
+#include <ROOT/TThreadExecutor.hxx>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "../common/converted_reader.h"
+#include "../common/entry_ranges.h"
+#include "../common/oscillation.h"
+
+using namespace std;
+
+// Electron fraction of the matter; the fixed parameters and the nominal
+// point are NominalOscParams(), shared with the other oscillation macros
+const double scan_Ye = 0.5;
+
+// Summed nu_e and nu_mu event weights in one energy sub-bin
+struct SpectrumCell {
+    double E;      // weight-averaged energy of both flavours
+    double w[2];   // summed weight of e and mu, already scaled to the exposure
+    int bin;       // bin of the analysis spectrum
+    bool anti;
+};
+
+// Predicted spectra for one parameter point: the nu_mu-like sample in
+// spectrum[0, nbins), the nu_e-like one in spectrum[nbins, 2 nbins)
+void predict_spectrum(const vector<SpectrumCell>& cells, const OscParams& p,
+                      double Lkm, double rho, int nbins, vector<double>& spectrum) {
+    const Matrix3 Hvac[2] = {VacuumHamiltonian(p, false), VacuumHamiltonian(p, true)};
+    fill(spectrum.begin(), spectrum.end(), 0.0);
+    double P[3][3];
+    for (const SpectrumCell& c : cells) {
+        OscProbabilities(Hvac[c.anti], c.E, Lkm, rho, scan_Ye, c.anti, P);
+        spectrum[c.bin] += c.w[0] * P[0][1] + c.w[1] * P[1][1];
+        spectrum[nbins + c.bin] += c.w[0] * P[0][0] + c.w[1] * P[1][0];
+    }
+}
+
+void osc_grid_scan(const char* filename = "genie_output.root",
+                   int ns23 = 40, int ndm31 = 40, int ndcp = 36, int nthreads = 0,
+                   double baseline_km = 810.0, double density = 2.8,
+                   double exposure = 1000.0, const char* output = "osc_grid_scan.root") {
+
+    // Analysis binning and the finer binning the events are reduced to; the
+    // probabilities are computed once per sub-bin and grid point, so nsub
+    // sets the cost of the scan
+    const int nbins = 50, nsub = 4;
+    const double Emin = 0.0, Emax = 5.0;
+    const double subWidth = (Emax - Emin) / (nbins * nsub);
+
+    // --- Read the events once
+    ConvertedReader reader(filename, ConvertedReader::kNoParticles);
+    if (!reader.IsOpen()) return;
+    // [anti][flavour][sub-bin]
+    vector<double> sumW(4 * nbins * nsub, 0), sumWE(4 * nbins * nsub, 0);
+    double total = 0;
+    for (Long64_t i = 0; i < reader.GetEntries(); i++) {
+        reader.GetEntry(i);
+        int f = NeutrinoFlavour(reader.nupdg);
+        if (f < 0 || f > 1 || reader.nuE <= Emin || reader.nuE >= Emax) continue;
+        int s = (int)((reader.nuE - Emin) / subWidth);
+        int k = (2*(reader.nupdg < 0) + f) * nbins * nsub + s;
+        sumW[k] += reader.xsection;
+        sumWE[k] += reader.xsection * reader.nuE;
+        total += reader.xsection;
+    }
+    if (total <= 0) {
+        cerr << "Error: no nu_e or nu_mu events between " << Emin << " and " << Emax << " GeV in " << filename << endl;
+        return;
+    }
+    vector<SpectrumCell> cells;
+    for (int anti = 0; anti < 2; anti++) {
+        for (int s = 0; s < nbins * nsub; s++) {
+            const int ke = 2*anti * nbins * nsub + s, km = ke + nbins * nsub;
+            const double w = sumW[ke] + sumW[km];
+            if (w <= 0) continue;
+            cells.push_back({(sumWE[ke] + sumWE[km]) / w,
+                             {sumW[ke] * exposure / total, sumW[km] * exposure / total},
+                             s / nsub, anti == 1});
+        }
+    }
+    cout << "Reduced " << reader.GetEntries() << " events to " << cells.size() << " energy cells" << endl;
+
+    // --- Reference spectra at the nominal point
+    vector<double> ref(2 * nbins);
+    const OscParams nominal = NominalOscParams();
+    predict_spectrum(cells, nominal, baseline_km, density, nbins, ref);
+
+    // --- Grid, points at the bin centres of the output histograms
+    TH3D* h_chi2 = new TH3D("h_chi2", "#chi^{2};sin^{2}#theta_{23};#Deltam^{2}_{31} [eV^{2}];#delta_{CP}",
+                            ns23, 0.35, 0.65, ndm31, 2.2e-3, 2.8e-3, ndcp, 0, 2*M_PI);
+    TH3D* h_m2lnL = (TH3D*)h_chi2->Clone("h_m2lnL");
+    h_m2lnL->SetTitle("-2 ln L (Poisson)");
+    const long npoints = (long)ns23 * ndm31 * ndcp;
+    vector<double> chi2(npoints), m2lnL(npoints);
+
+    TStopwatch timer;
+    vector<EntryRange> blocks = SplitEntries(npoints, ResolveThreadCount(nthreads));
+    ROOT::TThreadExecutor pool(blocks.size());
+    pool.Foreach([&](unsigned int b) {
+            vector<double> mu(2 * nbins);
+            for (Long64_t n = blocks[b].begin; n < blocks[b].end; n++) {
+                int is = n / (ndm31 * ndcp), id = (n / ndcp) % ndm31, ic = n % ndcp;
+                OscParams p = nominal;
+                p.th23 = asin(sqrt(h_chi2->GetXaxis()->GetBinCenter(is + 1)));
+                p.dm31 = h_chi2->GetYaxis()->GetBinCenter(id + 1);
+                p.dcp = h_chi2->GetZaxis()->GetBinCenter(ic + 1);
+                predict_spectrum(cells, p, baseline_km, density, nbins, mu);
+                double c2 = 0, l2 = 0;
+                for (int k = 0; k < 2 * nbins; k++) {
+                    if (ref[k] > 0) {
+                        c2 += (mu[k] - ref[k]) * (mu[k] - ref[k]) / ref[k];
+                        // no prediction where events are observed: excluded
+                        l2 += mu[k] > 0 ? 2 * (mu[k] - ref[k] + ref[k] * log(ref[k] / mu[k])) : HUGE_VAL;
+                    } else {
+                        l2 += 2 * mu[k];
+                    }
+                }
+                chi2[n] = c2;
+                m2lnL[n] = l2;
+            }
+        }, ROOT::TSeqU(blocks.size()));
+    double t = timer.RealTime();
+    cout << "Scanned " << npoints << " points with " << blocks.size() << " threads in " << t
+         << " s (" << (t > 0 ? npoints / t : 0) << " points/s)" << endl;
+
+    // --- Fill the surfaces; profile over deltaCP
+    TH2D* h_prof = new TH2D("h_chi2_s23_dm31", "#Delta#chi^{2}, minimum over #delta_{CP};sin^{2}#theta_{23};#Deltam^{2}_{31} [eV^{2}]",
+                            ns23, 0.35, 0.65, ndm31, 2.2e-3, 2.8e-3);
+    double minChi2 = 1e300;
+    for (long n = 0; n < npoints; n++) minChi2 = min(minChi2, chi2[n]);
+    for (int is = 0; is < ns23; is++) {
+        for (int id = 0; id < ndm31; id++) {
+            double best = 1e300;
+            for (int ic = 0; ic < ndcp; ic++) {
+                long n = ((long)is * ndm31 + id) * ndcp + ic;
+                h_chi2->SetBinContent(is + 1, id + 1, ic + 1, chi2[n]);
+                h_m2lnL->SetBinContent(is + 1, id + 1, ic + 1, m2lnL[n]);
+                best = min(best, chi2[n]);
+            }
+            h_prof->SetBinContent(is + 1, id + 1, best - minChi2);
+        }
+    }
+
+    TH1D* h_ref_mu = new TH1D("h_ref_mu", "Reference spectrum, #nu_{#mu}-like;E_{#nu} [GeV];Events", nbins, Emin, Emax);
+    TH1D* h_ref_e = new TH1D("h_ref_e", "Reference spectrum, #nu_{e}-like;E_{#nu} [GeV];Events", nbins, Emin, Emax);
+    for (int k = 0; k < nbins; k++) {
+        h_ref_mu->SetBinContent(k + 1, ref[k]);
+        h_ref_e->SetBinContent(k + 1, ref[nbins + k]);
+    }
+
+    TFile out(output, "RECREATE");
+    out.WriteTObject(h_ref_mu);
+    out.WriteTObject(h_ref_e);
+    out.WriteTObject(h_chi2);
+    out.WriteTObject(h_m2lnL);
+    out.WriteTObject(h_prof);
+    out.Close();
+    cout << "Saved " << output << endl;
+}
@@ -1,104 +1,279 @@
 // To run this program
 // root -l 'reconstruct_energy.cc("../truth.ghep_converted.root")'
+// or on 8 threads (0 = all cores)
+// root -l 'reconstruct_energy.cc("../truth.ghep_converted.root", 8)'
+// For a file that is still being appended to, keep a checkpoint; every
+// rerun with it only reads the new entries
+// root -l 'reconstruct_energy.cc("../truth.ghep_converted.root", 8, "reco_checkpoint.root")'
+// With a baseline [km] (and density [g/cm3]) the true and calorimetric
+// spectra are also drawn after exact three-flavour oscillations. The
+// per-event weights stored by osc_approx_matter in <file>_oscw.root
+// (common/osc_weights.h) are read as a friend column in the same pass;
+// without them each event is weighted from the interpolation tables
+// root -l 'reconstruct_energy.cc("../truth.ghep_converted.root", 8, "", 810, 2.8)'
+// With a flux file every event is weighted with flux x xsection x POT
+// (common/flux_weights.h) and the spectra are absolute rates per target
+// root -l 'reconstruct_energy.cc("../truth.ghep_converted.root", 8, "", 0, 2.8, "../RHC_Flux_NOvA_ND_2017.root", 1e21)'
+// The response is also saved as a sparse, column-normalised matrix
+// (common/response_matrix.h) in response_matrix.root, for folding predicted
+// true-energy spectra without the events.
+// Four energy estimators (calorimetric, CCQE, hadronic + lepton,
+// proton-tagged) are evaluated on every event in the same pass and their
+// fractional residuals compared in estimator_resolution.png.
+// With a number of systematic universes (common/syst_universes.h) the
+// calorimetric and CCQE spectra are also filled for that many variations
+// of the binding energy, nucleon masses and energy scale in the same pass;
+// the spread between universes is drawn as a band and the universe
+// spectra are saved to reco_universes.root
+// root -l 'reconstruct_energy.cc("../truth.ghep_converted.root", 8, "", 0, 2.8, "", 1e21, 100)'
+// With a number of bootstrap replicas (common/bootstrap.h) the errors of
+// the true, calorimetric and kinematic spectra come from Poisson-weighted
+// replicas filled in the same pass; variances and covariance matrices are
+// saved to reco_bootstrap.root
+// root -l 'reconstruct_energy.cc("../truth.ghep_converted.root", 8, "", 0, 2.8, "", 1e21, 0, 200)'
 
 #include <TFile.h>
 #include <TTree.h>
 #include <TH1D.h>
 #include <TH2D.h>
 #include <TCanvas.h>
+#include <TLegend.h>
 #include <TMath.h>
+#include <TStopwatch.h>
 #include <iostream>
 #include <vector>
 
-void reconstruct_energy(const char* filename = "genie_output.root") {
-
-    // Open file
-    TFile* f = TFile::Open(filename);
-    if (!f || f->IsZombie()) { std::cerr << "Error: cannot open file\n"; return; }
-
-    // Get trees
-    TTree* tevent = (TTree*)f->Get("Event");
-    TTree* tpart  = (TTree*)f->Get("Particles");
-    if (!tevent || !tpart) { std::cerr << "Error: trees not found\n"; return; }
-
-    // Event-level branches
-    double nuE, xsection;
-    bool IsCC;
-    tevent->SetBranchAddress("nuE", &nuE);
-    tevent->SetBranchAddress("xsection", &xsection);
-    tevent->SetBranchAddress("IsCC", &IsCC);
-
-    // Particle-level branches
-    std::vector<int>* pdg = nullptr;
-    std::vector<int>* status = nullptr;
-    std::vector<double>* energy = nullptr;
-    std::vector<double>* px = nullptr;
-    std::vector<double>* py = nullptr;
-    std::vector<double>* pz = nullptr;
-
-    tpart->SetBranchAddress("pdg", &pdg);
-    tpart->SetBranchAddress("status", &status);
-    tpart->SetBranchAddress("energy", &energy);
-    tpart->SetBranchAddress("px", &px);
-    tpart->SetBranchAddress("py", &py);
-    tpart->SetBranchAddress("pz", &pz);
-
-    // Constants
-    const double Mn = 939.565;   // MeV
-    const double Mp = 938.272;   // MeV
-    const double Eb = 27.0;      // binding energy (MeV)
-    const double mmu = 105.66;   // MeV
-
-    // Histograms
-    TH1D* h_true = new TH1D("h_true", "True Neutrino Energy;E_{#nu}^{true} [GeV];Events", 50, 0, 5);
-    TH1D* h_cal  = new TH1D("h_cal",  "Calorimetric Reconstructed Energy;E_{#nu}^{cal} [GeV];Events", 50, 0, 5);
-    TH1D* h_qe   = new TH1D("h_qe",   "Kinematic Reconstructed Energy;E_{#nu}^{QE} [GeV];Events", 50, 0, 5);
-    TH2D* h_resp = new TH2D("h_resp", "Response Matrix;E_{#nu}^{true} [GeV];E_{#nu}^{cal} [GeV]", 50, 0, 5, 50, 0, 5);
-
-    Long64_t nEntries = tevent->GetEntries();
-    for (Long64_t i = 0; i < nEntries; ++i) {
-        tevent->GetEntry(i);
-        tpart->GetEntry(i);
-        if (!IsCC) continue;
-
-        // --- True energy ---
-        double Etrue = nuE * 1000.0; // convert to MeV
-
-        // --- Calorimetric energy ---
-        double Ecal = 0;
-        for (size_t j = 0; j < status->size(); ++j) {
-            if (status->at(j) != 1) continue;
-            double E = energy->at(j) * 1000.0; // MeV
-            int pid = pdg->at(j);
-            double mass = 0;
-            if (abs(pid) == 13) mass = 105.66;
-            else if (abs(pid) == 211) mass = 139.57;
-            else if (abs(pid) == 2212) mass = 938.27;
-            else if (abs(pid) == 2112) mass = 939.57;
-            else if (abs(pid) == 111) mass = 134.97;
-            else continue;
-            double kinE = E - mass;
-            if (kinE > 0) Ecal += kinE;
-        }
+#include "../common/converted_reader.h"
+#include "../common/hist_engine.h"
+#include "../common/osc_weights.h"
+#include "../common/flux_weights.h"
+#include "../common/response_matrix.h"
+#include "../common/energy_estimators.h"
+#include "../common/syst_universes.h"
+#include "../common/bootstrap.h"
+
+// Estimators evaluated on every event (common/energy_estimators.h), in
+// the order of RecoRow::E
+typedef EstimatorSet<CalorimetricEstimator, CCQEEstimator, HadronicPlusLeptonEstimator,
+                     ProtonTaggedEstimator> RecoEstimators;
+enum RecoEstimator { kCalorimetric, kCCQE, kHadronicLepton, kProtonTagged };
+
+// Energies of one CC event [GeV] and its weight
+struct RecoRow {
+    double Etrue, w;
+    double E[RecoEstimators::N]; // reconstructed, < 0 where an estimator does not apply
+    Long64_t entry;
+    double posc; // survival probability, with a baseline
+    double Ecal_u[kMaxUniverses], Eqe_u[kMaxUniverses]; // per systematic universe
+};
+
+bool compute_reco(ConvertedReader& reader, RecoRow& row) {
+    if (!reader.IsCC) return false;
+    row.w = reader.xsection;
+    row.entry = reader.CurrentEntry();
+    row.Etrue = reader.nuE;
+    RecoEstimators::Evaluate(reader, row.E);
+    return true;
+}
+
+void reconstruct_energy(const char* filename = "genie_output.root", int nthreads = 1,
+                        const char* checkpoint = "", double baseline_km = 0, double density = 2.8,
+                        const char* fluxFile = "", double pot = 1e21, int nuniverses = 0,
+                        int nreplicas = 0) {
+
+    // The sample normalisation is applied after the run, once the number
+    // of entries is known (the file may have grown since the checkpoint)
+    FluxWeighter flux;
+    if (fluxFile[0]) {
+        if (!flux.Load(fluxFile)) return;
+        flux.SetExposure(pot);
+    }
+    SystUniverses universes;
+    if (nuniverses > 0) {
+        if (!universes.Generate(nuniverses)) return;
+        std::cout << nuniverses << " systematic universes:" << std::endl;
+        universes.Print();
+    }
+
+    // Survival probabilities: the stored column if it matches the file
+    // (read entry by entry as a friend of the event tree), otherwise from
+    // the tables for each event. Nothing is written here
+    OscTable oscTable[2];
+    OscWeightFile oscStore(filename);
+    std::string oscTree;
+    if (baseline_km > 0) {
+        oscTable[0].Build(NominalOscParams(), baseline_km, density, 0.5, false);
+        oscTable[1].Build(NominalOscParams(), baseline_km, density, 0.5, true);
+        ConvertedReader probe(filename, ConvertedReader::kNoParticles);
+        if (!probe.IsOpen()) return;
+        const std::string key = ExactWeightKey(filename, NominalOscParams(), baseline_km, density, 0.5);
+        if (!probe.IsNtuple() && oscStore.Has("Pexact", key, probe.GetEntries()))
+            oscTree = OscWeightFile::TreeName("Pexact", key);
+        if (oscTree.empty())
+            std::cout << "No stored oscillation weights for this file, computing them from the tables" << std::endl;
+        else
+            std::cout << "Oscillation weights " << oscTree << " read from " << oscStore.Path() << std::endl;
+    }
+
+    // Histograms, filled in one pass; both the vector and the flat particle
+    // layout are read
+    typedef const RecoRow& R;
+    auto weight = [](R r){ return r.w; };
+    HistEngine<RecoRow> engine([&](ConvertedReader& reader, RecoRow& row) {
+            if (!compute_reco(reader, row)) return false;
+            if (flux.IsLoaded()) row.w = flux.Weight(reader.nupdg, reader.nuE, reader.xsection);
+            if (baseline_km > 0)
+                row.posc = reader.NFriendColumns() > 0 ? reader.FriendColumn(0)
+                                                       : ExactSurvivalWeight(oscTable, reader.nupdg, reader.nuE);
+            if (universes.N() > 0) universes.Evaluate(reader, row.Ecal_u, row.Eqe_u);
+            return true;
+        });
+    if (!oscTree.empty())
+        engine.SetReaderSetup([&](ConvertedReader& reader) {
+                reader.AddFriendColumn(oscStore.Path().c_str(), oscTree.c_str(), "Pexact");
+            });
+    TH1D* h_true = engine.Book1D("h_true", "True Neutrino Energy;E_{#nu}^{true} [GeV];Events", 50, 0, 5,
+                                 [](R r){ return r.Etrue; }, weight);
+    TH1D* h_cal  = engine.Book1D("h_cal",  "Calorimetric Reconstructed Energy;E_{#nu}^{cal} [GeV];Events", 50, 0, 5,
+                                 [](R r){ return r.E[kCalorimetric]; }, weight);
+    TH1D* h_qe   = engine.Book1D("h_qe",   "Kinematic Reconstructed Energy;E_{#nu}^{QE} [GeV];Events", 50, 0, 5,
+                                 [](R r){ return r.E[kCCQE]; }, weight, [](R r){ return r.E[kCCQE] > 0; });
+    TH2D* h_resp = engine.Book2D("h_resp", "Response Matrix;E_{#nu}^{true} [GeV];E_{#nu}^{cal} [GeV]", 50, 0, 5, 50, 0, 5,
+                                 [](R r){ return r.Etrue; }, [](R r){ return r.E[kCalorimetric]; }, weight);
+
+    // Per-event comparison of all estimators: fractional residuals
+    TH1D* h_frac[RecoEstimators::N];
+    for (size_t k = 0; k < RecoEstimators::N; k++)
+        h_frac[k] = engine.Book1D(Form("h_frac_%zu", k),
+                                  Form("%s;(E_{reco} - E_{true}) / E_{true};Events", RecoEstimators::Name(k)), 100, -1, 1,
+                                  [k](R r){ return (r.E[k] - r.Etrue) / r.Etrue; }, weight,
+                                  [k](R r){ return r.E[k] >= 0 && r.Etrue > 0; });
+
+    // Oscillated spectra, weighted with the survival probabilities
+    TH1D *h_true_osc = nullptr, *h_cal_osc = nullptr;
+    if (baseline_km > 0) {
+        auto oscWeight = [](R r){ return r.w * r.posc; };
+        h_true_osc = engine.Book1D("h_true_osc", "True Neutrino Energy, oscillated;E_{#nu}^{true} [GeV];Events", 50, 0, 5,
+                                   [](R r){ return r.Etrue; }, oscWeight);
+        h_cal_osc  = engine.Book1D("h_cal_osc", "Calorimetric Reconstructed Energy, oscillated;E_{#nu}^{cal} [GeV];Events", 50, 0, 5,
+                                   [](R r){ return r.E[kCalorimetric]; }, oscWeight);
+    }
 
-        // --- Kinematic QE energy ---
-        double Eqe = -999;
-        for (size_t j = 0; j < pdg->size(); ++j) {
-            if (abs(pdg->at(j)) == 13 && status->at(j) == 1) {
-                double E_mu = energy->at(j) * 1000.0;
-                double p_mu = sqrt(px->at(j)*px->at(j) + py->at(j)*py->at(j) + pz->at(j)*pz->at(j)) * 1000.0;
-                double costh = pz->at(j) / sqrt(px->at(j)*px->at(j) + py->at(j)*py->at(j) + pz->at(j)*pz->at(j));
-                Eqe = (2*(Mn - Eb)*E_mu - (Eb*Eb - 2*Mn*Eb + mmu*mmu + (Mn*Mn - Mp*Mp))) /
-                      (2*((Mn - Eb) - E_mu + p_mu * costh));
-                break;
+    // Spectra in every universe, one TH2D row each
+    TH2D *h_cal_univ = nullptr, *h_qe_univ = nullptr;
+    if (nuniverses > 0) {
+        h_cal_univ = engine.BookUniverses("h_cal_univ", "Calorimetric energy per universe;E_{#nu}^{cal} [GeV];universe",
+                                          nuniverses, 50, 0, 5, [](R r){ return r.Ecal_u; }, weight);
+        h_qe_univ  = engine.BookUniverses("h_qe_univ", "Kinematic energy per universe;E_{#nu}^{QE} [GeV];universe",
+                                          nuniverses, 50, 0, 5, [](R r){ return r.Eqe_u; }, weight);
+    }
+
+    // True energies of the CC events for the flat-sample check of the flux
+    // normalisation; the CC fraction changes slowly enough with energy
+    TH1D* h_sample = nullptr;
+    if (flux.IsLoaded())
+        h_sample = engine.Book1D("h_flux_sample", "Sample, CC events;E_{#nu}^{true} [GeV];Events", kSampleCheckBins,
+                                 flux.EnergyLow(), flux.EnergyHigh(), [](R r){ return r.Etrue; });
+
+    // Bootstrap replicas of the energy spectra
+    TH1D* boot[] = {h_true, h_cal, h_qe, h_true_osc, h_cal_osc};
+    TH2D* bootReplicas[5] = {};
+    for (int k = 0; k < 5 && nreplicas > 0; k++)
+        if (boot[k]) bootReplicas[k] = engine.BookBootstrap(boot[k], nreplicas);
+
+    // Settings a checkpoint must have been written with
+    engine.SetConfiguration(Form("baseline=%g;density=%g;flux=%s;pot=%g;universes=%d",
+                                 baseline_km, density, fluxFile, pot, nuniverses));
+    bool ok = checkpoint[0] ? engine.RunIncremental(filename, checkpoint, ConvertedReader::kParticles, nthreads)
+                            : engine.Run(filename, ConvertedReader::kParticles, nthreads);
+    if (!ok) return;
+
+    // Flux-weighted histograms (and the checkpoint) hold unnormalised sums.
+    // A skimmed file is normalised to the events generated before the skim,
+    // and the events it kept need not be flat; any other sample that is not
+    // flat cannot be normalised, so the macro stops before any output
+    if (flux.IsLoaded()) {
+        if (engine.GetGeneratedEntries() != engine.GetEntries())
+            std::cout << "Skimmed input: " << engine.GetEntries() << " of " << engine.GetGeneratedEntries()
+                      << " generated events kept, the flat-sample check is skipped" << std::endl;
+        else if (!flux.CheckFlatSample(h_sample))
+            return;
+        flux.SetSample(engine.GetGeneratedEntries(), flux.EnergyLow(), flux.EnergyHigh());
+        for (size_t k = 0; k < engine.NHists(); k++)
+            if (engine.Hist(k) != h_sample) flux.Normalise(engine.Hist(k));
+    }
+
+    // --- Sparse response. Folding h_true reproduces h_cal apart from
+    // events with a true energy outside the histogram range
+    ResponseMatrix resp;
+    resp.FromHist(h_resp);
+    TFile respFile("response_matrix.root", "RECREATE");
+    resp.Write(&respFile, "resp_cal");
+    respFile.Close();
+    TH1D* h_fold = resp.Fold(h_true, "h_true_folded");
+    double maxDiff = 0;
+    for (int b = 1; b <= h_cal->GetNbinsX(); b++)
+        maxDiff = std::max(maxDiff, std::fabs(h_fold->GetBinContent(b) - h_cal->GetBinContent(b)));
+    std::cout << "Response matrix: " << resp.NonZeros() << " of " << resp.NTrue() * resp.NReco()
+              << " bins nonzero, " << resp.MemoryBytes() << " bytes, saved to response_matrix.root" << std::endl;
+    std::cout << "Max |folded h_true - h_cal| per bin: " << maxDiff
+              << " (h_cal integral " << h_cal->Integral() << ")" << std::endl;
+
+    // Folding cost as seen by a fit: many spectra in one batch
+    const int nspectra = 1000;
+    std::vector<double> truthBatch((size_t)resp.NTrue() * nspectra), recoBatch((size_t)resp.NReco() * nspectra);
+    for (int t = 0; t < resp.NTrue(); t++)
+        for (int s = 0; s < nspectra; s++) truthBatch[(size_t)t * nspectra + s] = h_true->GetBinContent(t + 1);
+    TStopwatch foldTimer;
+    resp.FoldBatch(truthBatch.data(), nspectra, recoBatch.data());
+    std::cout << "Batched folding: " << foldTimer.RealTime() / nspectra * 1e6 << " us per spectrum" << std::endl;
+
+    // --- Universe spread: nominal spectrum with the RMS over universes
+    TH1D *h_cal_syst = nullptr, *h_qe_syst = nullptr;
+    if (nuniverses > 0) {
+        TFile univFile("reco_universes.root", "RECREATE");
+        univFile.WriteTObject(h_cal_univ);
+        univFile.WriteTObject(h_qe_univ);
+        univFile.Close();
+        TH2D* univ[2] = {h_cal_univ, h_qe_univ};
+        TH1D* syst[2];
+        for (int k = 0; k < 2; k++) {
+            syst[k] = univ[k]->ProjectionX(Form("%s_syst", univ[k]->GetName()), 1, 1);
+            for (int b = 1; b <= syst[k]->GetNbinsX(); b++) {
+                double sum = 0, sum2 = 0;
+                for (int u = 1; u <= nuniverses; u++) {
+                    const double c = univ[k]->GetBinContent(b, u);
+                    sum += c;
+                    sum2 += c * c;
+                }
+                const double mean = sum / nuniverses;
+                syst[k]->SetBinError(b, std::sqrt(std::max(sum2 / nuniverses - mean * mean, 0.0)));
             }
         }
+        h_cal_syst = syst[0];
+        h_qe_syst = syst[1];
+        std::cout << "Systematic universes saved to reco_universes.root" << std::endl;
+    }
 
-        // --- Fill histograms ---
-        h_true->Fill(Etrue/1000.0, xsection);
-        h_cal->Fill(Ecal/1000.0, xsection);
-        if (Eqe > 0) h_qe->Fill(Eqe/1000.0, xsection);
-        h_resp->Fill(Etrue/1000.0, Ecal/1000.0, xsection);
+    // --- Bootstrap errors replace the Sumw2 ones
+    if (nreplicas > 0) {
+        TFile bootFile("reco_bootstrap.root", "RECREATE");
+        for (int k = 0; k < 5; k++) {
+            if (!boot[k]) continue;
+            TH1D* var = BootstrapVariance(bootReplicas[k], Form("%s_var", boot[k]->GetName()));
+            TH2D* cov = BootstrapCovariance(bootReplicas[k], Form("%s_cov", boot[k]->GetName()));
+            double sumw2Error = 0;
+            const double integral = boot[k]->IntegralAndError(1, boot[k]->GetNbinsX(), sumw2Error);
+            SetBootstrapErrors(boot[k], var);
+            std::cout << boot[k]->GetName() << ": integral " << integral << " +- "
+                      << std::sqrt(cov->Integral()) << " (bootstrap, " << nreplicas << " replicas), +- "
+                      << sumw2Error << " (sum of w^2)" << std::endl;
+            bootFile.WriteTObject(bootReplicas[k]);
+            bootFile.WriteTObject(var);
+            bootFile.WriteTObject(cov);
+        }
+        bootFile.Close();
+        std::cout << "Bootstrap variances and covariances saved to reco_bootstrap.root" << std::endl;
     }
 
     // --- Draw ---
@@ -117,12 +292,48 @@ void reconstruct_energy(const char* filename = "genie_output.root") {
     leg->AddEntry(h_true,"True Energy","l");
     leg->AddEntry(h_cal,"Calorimetric Energy","l");
     leg->AddEntry(h_qe,"Kinematic Energy","l");
+    if (h_true_osc) {
+        h_true_osc->SetLineColor(kBlack);
+        h_cal_osc->SetLineColor(kGreen);
+        h_true_osc->SetLineStyle(2);
+        h_cal_osc->SetLineStyle(2);
+        h_true_osc->SetLineWidth(3);
+        h_cal_osc->SetLineWidth(3);
+        h_true_osc->Draw("HIST SAME");
+        h_cal_osc->Draw("HIST SAME");
+        leg->AddEntry(h_true_osc,"True Energy, oscillated","l");
+        leg->AddEntry(h_cal_osc,"Calorimetric Energy, oscillated","l");
+    }
+    if (h_cal_syst) {
+        h_cal_syst->SetFillColorAlpha(kGreen, 0.3);
+        h_qe_syst->SetFillColorAlpha(kBlue, 0.3);
+        h_cal_syst->SetMarkerSize(0);
+        h_qe_syst->SetMarkerSize(0);
+        h_cal_syst->Draw("E2 SAME");
+        h_qe_syst->Draw("E2 SAME");
+        leg->AddEntry(h_cal_syst, Form("Spread of %d universes", nuniverses), "f");
+    }
     leg->Draw();
 
     TCanvas* c2 = new TCanvas("c2","Response Matrix",800,700);
     h_resp->SetStats(0);
     h_resp->Draw("COLZ");
 
+    TCanvas* c3 = new TCanvas("c3", "Estimators", 900, 700);
+    auto legEst = new TLegend(0.12, 0.65, 0.45, 0.88);
+    const int colors[] = {kGreen + 2, kBlue, kRed, kMagenta};
+    for (size_t k = 0; k < RecoEstimators::N; k++) {
+        std::cout << RecoEstimators::Name(k) << ": mean " << h_frac[k]->GetMean()
+                  << ", RMS " << h_frac[k]->GetRMS() << " (fractional)" << std::endl;
+        h_frac[k]->SetStats(0);
+        h_frac[k]->SetLineColor(colors[k % 4]);
+        h_frac[k]->SetLineWidth(2);
+        h_frac[k]->Draw(k == 0 ? "HIST" : "HIST SAME");
+        legEst->AddEntry(h_frac[k], RecoEstimators::Name(k), "l");
+    }
+    legEst->Draw();
+
     c1->SaveAs("reconstructed_energy.png");
     c2->SaveAs("response_matrix.png");
+    c3->SaveAs("estimator_resolution.png");
 }
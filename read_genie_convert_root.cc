@@ -6,85 +6,540 @@
 //// To run this program, use following command
 //// $genie 'read_genie_convert_root.cc("gntp.0.ghep.root")'
 //// Here gntp.0.ghep.root is the genie output file.
+////
+//// To convert with several threads, pass the number of threads (0 = all cores)
+//// $genie 'read_genie_convert_root.cc("gntp.0.ghep.root", 8)'
+//// Each thread converts its own contiguous block of entries into a temporary
+//// file, and the blocks are merged in entry order, so the output is identical
+//// to the single-threaded one.
+////
+//// Besides the GHEP particles, every event stores the primary lepton
+//// (lepIndex, lepPdg, lepE), the transfer variables q3, omega, Q2, W, x, y
+//// and the visible hadronic energy Ehad, all computed from the lepton
+//// four-vector (common/kinematics.h) as the analysis macros do. GENIE's
+//// selected kinematics, which use the hit nucleon, are kept separately in
+//// Q2sel, Wsel, xsel and ysel (-1 where the generator did not set them).
+////
+//// Options are given as a string in the third argument:
+////   "flat"  : write particles as a per-event count np plus variable-length
+////             arrays status[np], pdg[np], ... instead of std::vector branches.
+////             Readers unpack them into fixed buffers without allocating,
+////             and blocks from different threads merge without rewriting.
+////             Events with more than kMaxParticles (1000) particles keep
+////             the first kMaxParticles; their number is stored as
+////             "truncated=<n>" in ConversionInfo (also for "rntuple", whose
+////             reader has the same limit).
+////   "float" : store energy and momenta as 32-bit floats (implies "flat")
+////   "merged": write a single "Events" tree holding the event variables and
+////             the particle branches, so readers need one GetEntry and one
+////             TTreeCache per event (works with "flat" and "float")
+////   "rntuple": write one "Events" RNTuple instead of the TTrees, with the
+////             event fields and the particles as a nested "particles"
+////             collection ("float" applies to it as well). ROOT 6.30 cannot
+////             merge RNTuples, so this mode always converts on one thread.
+////   "profile=<name>": compression and basket settings of the output,
+////             "archive" (LZMA, smallest files), "balanced" (ZSTD) or
+////             "analysis" (LZ4 with large baskets, fastest to reread).
+////             Without a profile ROOT's defaults are used.
+////
+//// Skim options keep only part of the sample; the selection is stored in
+//// the output as the title of the "Selection" TNamed:
+////   "current=cc" or "current=nc"     : charged or neutral current events
+////   "mode=qe,res,dis,coh,mec"         : events of any of these types
+////   "nupdg=14,-14"                    : probe flavours
+////   "emin=0.5 emax=5"                 : neutrino energy range [GeV]
+////   "status=1"                        : keep only particles with these GHEP
+////                                       status codes (1 = final state)
+//// With a status filter lepIndex points into the kept particles (-1 if the
+//// primary lepton was dropped); Ehad always uses all final-state particles.
+//// $genie 'read_genie_convert_root.cc("gntp.0.ghep.root", 8, "current=cc status=1")'
+////
+//// Memory stays flat however many events a file holds: the GHEP record is
+//// cleared before every entry and all readers and outputs are freed. With
+////   "stream" or "stream=<MB>" : output buffers are flushed to disk whenever
+////                               <MB> (default 32) of compressed data pile up,
+//// and RSS, peak RSS and heap growth per event are logged every 100k events
+//// on one thread; with several threads these process-wide figures are
+//// logged once, after all ranges are converted.
+//// $genie 'read_genie_convert_root.cc("gntp.0.ghep.root", 8, "flat float")'
+//// $genie 'read_genie_convert_root.cc("gntp.0.ghep.root", 8, "merged profile=analysis")'
+//// After converting a file, a short report prints bytes/event, the
+//// compression ratio and the read-back speed, to help choosing a profile.
+////
+//// To convert a whole generation campaign, 4 files at a time, use
+//// $genie -l
+//// root [0] .L read_genie_convert_root.cc
+//// root [1] read_genie_convert_campaign("gntp.*.ghep.root", 4, "", "campaign_converted.root")
+//// Files whose output is already complete for the same input and options are
+//// skipped, so after a crash the same command resumes where it stopped.
+//// The last argument is optional and merges all outputs into one file, with
+//// one ConversionInfo/Selection record for the whole campaign.
 #include <TTree.h>
 #include <TFile.h>
 #include <TTree.h>
 #include <TString.h>
+#include <TSystem.h>
+#include <TStopwatch.h>
+#include <TFileMerger.h>
+#include <TChain.h>
+#include <TNamed.h>
+#include <TObjArray.h>
+#include <TObjString.h>
+#include <TROOT.h>
+#include <Compression.h>
+#include <ROOT/TThreadExecutor.hxx>
+#include <ROOT/RNTuple.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#include <algorithm>
 #include <iostream>
+#include <vector>
+
+// The genie interpreter knows GENIE's classes already; compiled builds
+// (ACLiC or the mctool executable) need the headers
+#ifndef __CLING__
+#include "Framework/EventGen/EventRecord.h"
+#include "Framework/GHEP/GHepParticle.h"
+#include "Framework/GHEP/GHepStatus.h"
+#include "Framework/Interaction/Interaction.h"
+#include "Framework/Interaction/KineVar.h"
+#include "Framework/Ntuple/NtpMCEventRecord.h"
+#endif
+
+#include "common/entry_ranges.h"
+#include "common/converted_reader.h"
+#include "common/kinematics.h"
+#include "common/memory_monitor.h"
 
 using namespace genie;
 
-void read_genie_convert_root(const char* infile)
+// Named compression and basket settings of the output ("profile=<name>")
+struct OutputProfile {
+  const char* name;
+  int compression;       // ROOT compression settings, 100*algorithm + level
+  Int_t basketSize;      // bytes per TTree basket
+  Long64_t clusterBytes; // compressed bytes per cluster (TTree auto-flush, RNTuple cluster)
+};
+
+const OutputProfile kOutputProfiles[] = {
+  // long-term storage: best ratio, slow to compress and decompress
+  {"archive", ROOT::CompressionSettings(ROOT::RCompressionSetting::EAlgorithm::kLZMA, 8), 32000, 100000000},
+  // good ratio with fast decompression
+  {"balanced", ROOT::CompressionSettings(ROOT::RCompressionSetting::EAlgorithm::kZSTD, 5), 64000, 50000000},
+  // files reread many times: fast LZ4 and large baskets, so fewer and larger reads
+  {"analysis", ROOT::CompressionSettings(ROOT::RCompressionSetting::EAlgorithm::kLZ4, 4), 256000, 50000000},
+};
+
+const OutputProfile* find_output_profile(const TString& name)
+{
+  for (const OutputProfile& p : kOutputProfiles)
+    if (name == p.name) return &p;
+  return nullptr;
+}
+
+// Compression of the output, ROOT's default without a profile
+int profile_compression(const OutputProfile* profile)
+{
+  return profile ? profile->compression : ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault;
+}
+
+void apply_output_profile(TTree* tree, const OutputProfile* profile)
+{
+  if (!profile) return;
+  tree->SetBasketSize("*", profile->basketSize);
+  tree->SetAutoFlush(-profile->clusterBytes);
+}
+
+// Conversion-time skim: events failing the selection are not written, and
+// only particles with an accepted status code are kept
+struct EventSelection {
+  enum { kAnyCurrent, kCC, kNC };
+  enum { kQE = 1, kRES = 2, kDIS = 4, kCoh = 8, kMEC = 16 };
+
+  int current = kAnyCurrent;
+  int modes = 0;            // interaction type bits, 0 = any
+  std::vector<int> nupdg;   // empty = any flavour
+  double emin = -1, emax = -1; // < 0 = no limit
+  std::vector<int> status;  // empty = all particles
+
+  // Parse one key=value option; false if the key is not a selection
+  bool Parse(const TString& key, const TString& value)
+  {
+    if (key == "current") {
+      if (value == "cc") current = kCC;
+      else if (value == "nc") current = kNC;
+      else return false;
+    } else if (key == "mode") {
+      std::vector<TString> names = SplitList(value);
+      for (const TString& m : names) {
+        if (m == "qe") modes |= kQE;
+        else if (m == "res") modes |= kRES;
+        else if (m == "dis") modes |= kDIS;
+        else if (m == "coh") modes |= kCoh;
+        else if (m == "mec") modes |= kMEC;
+        else return false;
+      }
+    } else if (key == "nupdg") {
+      for (const TString& v : SplitList(value)) nupdg.push_back(v.Atoi());
+    } else if (key == "emin") {
+      emin = value.Atof();
+    } else if (key == "emax") {
+      emax = value.Atof();
+    } else if (key == "status") {
+      for (const TString& v : SplitList(value)) status.push_back(v.Atoi());
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  bool PassEvent(int pdg, double E, bool cc, bool nc,
+                 bool qe, bool res, bool dis, bool coh, bool mec) const
+  {
+    if (current == kCC && !cc) return false;
+    if (current == kNC && !nc) return false;
+    if (modes) {
+      int m = (qe ? kQE : 0) | (res ? kRES : 0) | (dis ? kDIS : 0) | (coh ? kCoh : 0) | (mec ? kMEC : 0);
+      if (!(m & modes)) return false;
+    }
+    if (!nupdg.empty() && std::find(nupdg.begin(), nupdg.end(), pdg) == nupdg.end()) return false;
+    if (emin >= 0 && E < emin) return false;
+    if (emax >= 0 && E > emax) return false;
+    return true;
+  }
+
+  bool KeepParticle(int st) const
+  {
+    return status.empty() || std::find(status.begin(), status.end(), st) != status.end();
+  }
+
+  // The selection in option syntax, "none" if everything is kept
+  TString Describe() const
+  {
+    TString d;
+    if (current == kCC) d += " current=cc";
+    if (current == kNC) d += " current=nc";
+    if (modes) {
+      const char* names[] = {"qe", "res", "dis", "coh", "mec"};
+      TString list;
+      for (int b = 0; b < 5; b++)
+        if (modes & (1 << b)) list += TString(list.IsNull() ? "" : ",") + names[b];
+      d += " mode=" + list;
+    }
+    if (!nupdg.empty()) d += " nupdg=" + JoinList(nupdg);
+    if (emin >= 0) d += TString::Format(" emin=%g", emin);
+    if (emax >= 0) d += TString::Format(" emax=%g", emax);
+    if (!status.empty()) d += " status=" + JoinList(status);
+    if (d.IsNull()) return "none";
+    return TString(d.Strip(TString::kLeading));
+  }
+
+  static std::vector<TString> SplitList(const TString& value)
+  {
+    std::vector<TString> items;
+    TObjArray* tokens = value.Tokenize(",");
+    for (int k = 0; k < tokens->GetEntries(); k++)
+      items.push_back(((TObjString*)tokens->At(k))->GetString());
+    delete tokens;
+    return items;
+  }
+
+  static TString JoinList(const std::vector<int>& values)
+  {
+    TString list;
+    for (size_t k = 0; k < values.size(); k++) list += TString::Format(k ? ",%d" : "%d", values[k]);
+    return list;
+  }
+};
+
+// Output settings parsed from the option string
+struct ConvertOptions {
+  bool flat = false;     // flat particle arrays instead of std::vector
+  bool useFloat = false; // float32 energy and momenta
+  bool rntuple = false;  // RNTuple instead of TTrees
+  bool merged = false;   // one Events tree instead of Event + Particles
+  const OutputProfile* profile = nullptr; // nullptr = ROOT defaults
+  EventSelection selection;
+  Long64_t streamBytes = 0; // flush budget of the "stream" mode, 0 = off
+  bool logRangeMemory = true; // memory log per entry range, off with several
+                              // threads since the figures are process-wide
+};
+
+// Events between two memory log lines in the "stream" mode
+const Long64_t kMemoryLogInterval = 100000;
+
+// Options are separated by spaces, either flags or key=value pairs
+ConvertOptions parse_convert_options(const char* opt)
 {
+  ConvertOptions opts;
+  TString o(opt);
+  o.ToLower();
+  TObjArray* tokens = o.Tokenize(" ");
+  for (int k = 0; k < tokens->GetEntries(); k++) {
+    TString token = ((TObjString*)tokens->At(k))->GetString();
+    TString key = token, value;
+    Ssiz_t eq = token.First('=');
+    if (eq != kNPOS) {
+      key = token(0, eq);
+      value = token(eq + 1, token.Length());
+    }
+
+    if (key == "flat") opts.flat = true;
+    else if (key == "float") opts.useFloat = true;
+    else if (key == "rntuple") opts.rntuple = true;
+    else if (key == "merged") opts.merged = true;
+    else if (key == "stream") opts.streamBytes = (value.IsNull() ? 32 : value.Atoll()) * 1024 * 1024;
+    else if (key == "profile") {
+      opts.profile = find_output_profile(value);
+      if (!opts.profile)
+        std::cerr << "Warning: unknown output profile " << value << ", using ROOT defaults" << std::endl;
+    }
+    else if (!opts.selection.Parse(key, value))
+      std::cerr << "Warning: ignoring unknown option " << token << std::endl;
+  }
+  delete tokens;
+
+  if (opts.rntuple) {
+    opts.flat = false;
+    opts.merged = false;
+  } else if (opts.useFloat) {
+    opts.flat = true;
+  }
+  return opts;
+}
+
+// RNTuple output: the fields of one "Events" entry, with the particles
+// filled one by one into the nested "particles" collection
+struct NtupleWriter {
+  std::shared_ptr<int> nupdg;
+  std::shared_ptr<double> nuE, nuPx, nuPy, nuPz, xsection;
+  std::shared_ptr<bool> IsQE, IsRES, IsDIS, IsCoh, IsMEC, IsCC, IsNC;
+  std::shared_ptr<int> lepIndex, lepPdg;
+  std::shared_ptr<double> lepE, q3, omega, Q2, W, x, y, Ehad;
+  std::shared_ptr<double> Q2sel, Wsel, xsel, ysel;
+  std::shared_ptr<int> status, pdg;
+  std::shared_ptr<double> energy, px, py, pz;
+  std::shared_ptr<float> energyF, pxF, pyF, pzF;
+  std::shared_ptr<ROOT::Experimental::RCollectionNTupleWriter> particles;
+  std::unique_ptr<ROOT::Experimental::RNTupleWriter> writer;
+
+  NtupleWriter(const char* outName, bool useFloat, const OutputProfile* profile,
+               Long64_t clusterBytes)
+  {
+    using ROOT::Experimental::RNTupleModel;
+    auto model = RNTupleModel::Create();
+    nupdg = model->MakeField<int>("nupdg");
+    nuE = model->MakeField<double>("nuE");
+    nuPx = model->MakeField<double>("nuPx");
+    nuPy = model->MakeField<double>("nuPy");
+    nuPz = model->MakeField<double>("nuPz");
+    xsection = model->MakeField<double>("xsection");
+    IsQE = model->MakeField<bool>("IsQE");
+    IsRES = model->MakeField<bool>("IsRES");
+    IsDIS = model->MakeField<bool>("IsDIS");
+    IsCoh = model->MakeField<bool>("IsCoh");
+    IsMEC = model->MakeField<bool>("IsMEC");
+    IsCC = model->MakeField<bool>("IsCC");
+    IsNC = model->MakeField<bool>("IsNC");
+    lepIndex = model->MakeField<int>("lepIndex");
+    lepPdg = model->MakeField<int>("lepPdg");
+    lepE = model->MakeField<double>("lepE");
+    q3 = model->MakeField<double>("q3");
+    omega = model->MakeField<double>("omega");
+    Q2 = model->MakeField<double>("Q2");
+    W = model->MakeField<double>("W");
+    x = model->MakeField<double>("x");
+    y = model->MakeField<double>("y");
+    Ehad = model->MakeField<double>("Ehad");
+    Q2sel = model->MakeField<double>("Q2sel");
+    Wsel = model->MakeField<double>("Wsel");
+    xsel = model->MakeField<double>("xsel");
+    ysel = model->MakeField<double>("ysel");
+
+    auto particleModel = RNTupleModel::Create();
+    status = particleModel->MakeField<int>("status");
+    pdg = particleModel->MakeField<int>("pdg");
+    if (useFloat) {
+      energyF = particleModel->MakeField<float>("energy");
+      pxF = particleModel->MakeField<float>("px");
+      pyF = particleModel->MakeField<float>("py");
+      pzF = particleModel->MakeField<float>("pz");
+    } else {
+      energy = particleModel->MakeField<double>("energy");
+      px = particleModel->MakeField<double>("px");
+      py = particleModel->MakeField<double>("py");
+      pz = particleModel->MakeField<double>("pz");
+    }
+    particles = model->MakeCollection("particles", std::move(particleModel));
+
+    ROOT::Experimental::RNTupleWriteOptions writeOptions;
+    writeOptions.SetCompression(profile_compression(profile));
+    if (clusterBytes <= 0 && profile) clusterBytes = profile->clusterBytes;
+    if (clusterBytes > 0) writeOptions.SetApproxZippedClusterSize(clusterBytes);
+    writer = ROOT::Experimental::RNTupleWriter::Recreate(std::move(model), kEventsName, outName,
+                                                         writeOptions);
+  }
+
+  void FillParticle(int st, int id, double e, double x, double y, double z)
+  {
+    *status = st;
+    *pdg = id;
+    if (energyF) {
+      *energyF = e;
+      *pxF = x;
+      *pyF = y;
+      *pzF = z;
+    } else {
+      *energy = e;
+      *px = x;
+      *py = y;
+      *pz = z;
+    }
+    particles->Fill();
+  }
+};
+
+// Timing of one conversion block
+struct ConvertStats {
+  bool ok = false;
+  Long64_t nevents = 0;   // entries read
+  Long64_t nselected = 0; // entries written
+  Long64_t ntruncated = 0; // entries whose particles were cut to kMaxParticles
+  double seconds = 0;
+};
+
+// Convert entries [first, last) of gtree in infile into the Event and
+// Particles trees (or the merged Events tree or RNTuple) of outName. Every
+// call opens its own input reader and output file, so calls for different
+// blocks can run on different threads.
+ConvertStats convert_entries(const char* infile, const char* outName,
+                             Long64_t first, Long64_t last, const ConvertOptions& opts)
+{
+  ConvertStats stats;
+  TStopwatch timer;
+
   // Open input file
-  TFile *myFile = new TFile(infile, "READ");
+  TFile *myFile = TFile::Open(infile, "READ");
   if (!myFile || myFile->IsZombie()) {
     std::cerr << "Error: cannot open input file " << infile << std::endl;
-    return;
+    delete myFile;
+    return stats;
   }
   
   // Get tree
   TTree *myTree = dynamic_cast<TTree*>(myFile->Get("gtree"));
   if (!myTree) {
     std::cerr << "Error: could not find TTree 'gtree' in " << infile << std::endl;
-    return;
+    delete myFile;
+    return stats;
   }
   
   // Set branch
   NtpMCEventRecord* myEventRecord = new NtpMCEventRecord();
   myTree->SetBranchAddress("gmcrec", &myEventRecord);
   
-  int nentries = myTree->GetEntries();
-  
-  // Construct output file name
-  TString inName(infile);
-  TString outName = inName;
-  if (outName.EndsWith(".root")) outName.ReplaceAll(".root", "_converted.root");
-  else outName.Append("_converted.root");
-  
-  TFile *outputFile = new TFile(outName, "RECREATE");
-  TTree *Event = new TTree("Event", "Event info");
-  
   int nupdg;
   double nuE;
   double nuPx, nuPy, nuPz;
   double xsection;
   bool IsQE, IsRES, IsDIS, IsCoh, IsMEC, IsCC, IsNC;
-  double Q2, W;
-
-  //Add branches to event tree
-  Event->Branch("nupdg", &nupdg, "nupdg/I");
-  Event->Branch("nuE", &nuE, "nuE/D");
-  Event->Branch("nuPx", &nuPx, "nuPx/D");
-  Event->Branch("nuPy", &nuPy, "nuPy/D");
-  Event->Branch("nuPz", &nuPz, "nuPz/D");
-  Event->Branch("xsection", &xsection, "xsection/D");
-  Event->Branch("IsQE", &IsQE, "IsQE/O");
-  Event->Branch("IsRES", &IsRES, "IsRES/O");
-  Event->Branch("IsDIS", &IsDIS, "IsDIS/O");
-  Event->Branch("IsCoh", &IsCoh, "IsCoh/O");
-  Event->Branch("IsMEC", &IsMEC, "IsMEC/O");
-  Event->Branch("IsCC", &IsCC, "IsCC/O");
-  Event->Branch("IsNC", &IsNC, "IsNC/O");
-  //Event->Branch("Q2", &Q2, "Q2/D");
-  //Event->Branch("W", &W, "W/D");
-
-  TTree *Particles = new TTree("Particles", "Particles info");
+  // derived kinematics, see common/kinematics.h
+  int lepIndex, lepPdg;
+  double lepE, q3, omega, Ehad;
+  double Q2, W, x, y;
+  double Q2sel, Wsel, xsel, ysel; // GENIE's selected kinematics
 
   std::vector<int> status, pdg;
   std::vector<double> energy, px, py, pz;
+  FlatParticles *flat = nullptr;
+
+  TFile *outputFile = nullptr;
+  TTree *Event = nullptr;
+  TTree *Particles = nullptr;
+  NtupleWriter *ntuple = nullptr;
 
-  //add branches to Particles tree
-  Particles->Branch("status", &status);
-  Particles->Branch("pdg", &pdg);
-  Particles->Branch("energy", &energy);
-  Particles->Branch("px", &px);
-  Particles->Branch("py", &py);
-  Particles->Branch("pz", &pz);
+  if (opts.rntuple) {
+    ntuple = new NtupleWriter(outName, opts.useFloat, opts.profile, opts.streamBytes);
+  } else {
+    outputFile = new TFile(outName, "RECREATE", "", profile_compression(opts.profile));
+    if (opts.merged) Event = new TTree(kEventsName, "Event and particles info");
+    else Event = new TTree("Event", "Event info");
+
+    //Add branches to event tree
+    Event->Branch("nupdg", &nupdg, "nupdg/I");
+    Event->Branch("nuE", &nuE, "nuE/D");
+    Event->Branch("nuPx", &nuPx, "nuPx/D");
+    Event->Branch("nuPy", &nuPy, "nuPy/D");
+    Event->Branch("nuPz", &nuPz, "nuPz/D");
+    Event->Branch("xsection", &xsection, "xsection/D");
+    Event->Branch("IsQE", &IsQE, "IsQE/O");
+    Event->Branch("IsRES", &IsRES, "IsRES/O");
+    Event->Branch("IsDIS", &IsDIS, "IsDIS/O");
+    Event->Branch("IsCoh", &IsCoh, "IsCoh/O");
+    Event->Branch("IsMEC", &IsMEC, "IsMEC/O");
+    Event->Branch("IsCC", &IsCC, "IsCC/O");
+    Event->Branch("IsNC", &IsNC, "IsNC/O");
+    Event->Branch("lepIndex", &lepIndex, "lepIndex/I");
+    Event->Branch("lepPdg", &lepPdg, "lepPdg/I");
+    Event->Branch("lepE", &lepE, "lepE/D");
+    Event->Branch("q3", &q3, "q3/D");
+    Event->Branch("omega", &omega, "omega/D");
+    Event->Branch("Q2", &Q2, "Q2/D");
+    Event->Branch("W", &W, "W/D");
+    Event->Branch("x", &x, "x/D");
+    Event->Branch("y", &y, "y/D");
+    Event->Branch("Ehad", &Ehad, "Ehad/D");
+    Event->Branch("Q2sel", &Q2sel, "Q2sel/D");
+    Event->Branch("Wsel", &Wsel, "Wsel/D");
+    Event->Branch("xsel", &xsel, "xsel/D");
+    Event->Branch("ysel", &ysel, "ysel/D");
+
+    if (opts.merged) Particles = Event;
+    else Particles = new TTree("Particles", "Particles info");
+
+    //add branches to Particles tree
+    if (!opts.flat) {
+      Particles->Branch("status", &status);
+      Particles->Branch("pdg", &pdg);
+      Particles->Branch("energy", &energy);
+      Particles->Branch("px", &px);
+      Particles->Branch("py", &py);
+      Particles->Branch("pz", &pz);
+    } else {
+      flat = new FlatParticles();
+      Particles->Branch("np", &flat->np, "np/I");
+      Particles->Branch("status", flat->status, "status[np]/I");
+      Particles->Branch("pdg", flat->pdg, "pdg[np]/I");
+      if (opts.useFloat) {
+        Particles->Branch("energy", flat->energyF, "energy[np]/F");
+        Particles->Branch("px", flat->pxF, "px[np]/F");
+        Particles->Branch("py", flat->pyF, "py[np]/F");
+        Particles->Branch("pz", flat->pzF, "pz[np]/F");
+      } else {
+        Particles->Branch("energy", flat->energy, "energy[np]/D");
+        Particles->Branch("px", flat->px, "px[np]/D");
+        Particles->Branch("py", flat->py, "py[np]/D");
+        Particles->Branch("pz", flat->pz, "pz[np]/D");
+      }
+    }
+
+    apply_output_profile(Event, opts.profile);
+    if (Particles != Event) apply_output_profile(Particles, opts.profile);
+    if (opts.streamBytes > 0) {
+      Event->SetAutoFlush(-opts.streamBytes);
+      if (Particles != Event) Particles->SetAutoFlush(-opts.streamBytes);
+    }
+  }
+
+  MemoryMonitor *monitor = nullptr;
+  if (opts.streamBytes > 0 && opts.logRangeMemory)
+    monitor = new MemoryMonitor(TString::Format("entries [%lld, %lld)", first, last).Data());
 
   //Loop over event
-  for(int i=0; i<nentries; i++)
+  for(Long64_t i=first; i<last; i++)
     {
+      if (monitor && i > first && (i - first) % kMemoryLogInterval == 0) monitor->Log(i - first);
+
+      myEventRecord->Clear(); // frees the previous event's GHEP record
       myTree->GetEntry(i);
 
       genie::EventRecord *myEvent = myEventRecord->event;
@@ -114,8 +569,10 @@ void read_genie_convert_root(const char* infile)
       IsMEC = proc.IsMEC();
       IsCC = proc.IsWeakCC();
       IsNC = proc.IsWeakNC();
-      
-      Event->Fill();
+
+      if (!opts.selection.PassEvent(nupdg, nuE, IsCC, IsNC, IsQE, IsRES, IsDIS, IsCoh, IsMEC))
+        continue;
+      stats.nselected++;
       
       TObjArrayIter iter(myEvent);
       GHepParticle * p = 0;
@@ -125,10 +582,22 @@ void read_genie_convert_root(const char* infile)
       px.clear();
       py.clear();
       pz.clear();
+      Ehad = 0;
+      int ghepLepIndex = myEvent->FinalStatePrimaryLeptonPosition();
+      int ghepIndex = -1;
+      lepIndex = -1;
       
        //loop over event particles
        // $GENIE/Framework/GHEP/GHEPparticle.h
       while ((p = dynamic_cast<GHepParticle *>(iter.Next())) != nullptr) {
+	 ghepIndex++;
+
+	 if (p->Status() == kIStStableFinalState)
+	   Ehad += VisibleHadronicEnergy(p->Pdg(), p->P4()->Energy(), p->P4()->Px(),
+					 p->P4()->Py(), p->P4()->Pz());
+
+	 if (!opts.selection.KeepParticle(p->Status())) continue;
+	 if (ghepIndex == ghepLepIndex) lepIndex = (int)status.size();
 
 	 status.push_back(p->Status()); // 0=initial particles, 1=final particles
 	 pdg.push_back(p->Pdg());
@@ -139,11 +608,426 @@ void read_genie_convert_root(const char* infile)
 
 	 // Particles->Fill();
        }
-       Particles->Fill();
-       //delete myEventRecord;
-       //myEventRecord = nullptr;
+
+       // Transfer variables from the primary lepton four-vector; GENIE's
+       // selected kinematics go to separate branches, so Q2 = q3^2 - omega^2
+       // holds in every event
+       GHepParticle * lep = ghepLepIndex >= 0 ? myEvent->Particle(ghepLepIndex) : nullptr;
+       LeptonKinematics lk;
+       if (lep) {
+	 const TLorentzVector & k2 = *(lep->P4());
+	 lepPdg = lep->Pdg();
+	 lepE = k2.Energy();
+	 lk = ComputeLeptonKinematics(nuE, nuPx, nuPy, nuPz, k2.Energy(), k2.Px(), k2.Py(), k2.Pz());
+       } else {
+	 lepPdg = 0;
+	 lepE = -1;
+       }
+       q3 = lk.q3;
+       omega = lk.omega;
+       Q2 = lk.Q2;
+       W = lk.W;
+       x = lk.x;
+       y = lk.y;
+       Q2sel = kine.KVSet(kKVSelQ2) ? kine.Q2(true) : -1;
+       Wsel = kine.KVSet(kKVSelW) ? kine.W(true) : -1;
+       xsel = kine.KVSet(kKVSelx) ? kine.x(true) : -1;
+       ysel = kine.KVSet(kKVSely) ? kine.y(true) : -1;
+
+       // both fixed-buffer layouts hold at most kMaxParticles particles
+       if ((flat || ntuple) && (int)status.size() > kMaxParticles) stats.ntruncated++;
+       if (flat) {
+	 flat->np = (int)status.size();
+	 if (flat->np > kMaxParticles) {
+	   std::cerr << "Warning: entry " << i << " has " << flat->np
+		     << " particles, keeping the first " << kMaxParticles << std::endl;
+	   flat->np = kMaxParticles;
+	   // the primary lepton may be among the dropped particles
+	   if (lepIndex >= kMaxParticles) lepIndex = -1;
+	 }
+	 // only the precision bound to the branches is filled
+	 for (int j = 0; j < flat->np; j++) {
+	   flat->status[j] = status[j];
+	   flat->pdg[j] = pdg[j];
+	 }
+	 if (opts.useFloat) {
+	   for (int j = 0; j < flat->np; j++) {
+	     flat->energyF[j] = energy[j];
+	     flat->pxF[j] = px[j];
+	     flat->pyF[j] = py[j];
+	     flat->pzF[j] = pz[j];
+	   }
+	 } else {
+	   for (int j = 0; j < flat->np; j++) {
+	     flat->energy[j] = energy[j];
+	     flat->px[j] = px[j];
+	     flat->py[j] = py[j];
+	     flat->pz[j] = pz[j];
+	   }
+	 }
+       }
+       if (Event) Event->Fill();
+       if (Particles && Particles != Event) Particles->Fill();
+
+       if (ntuple) {
+	 *ntuple->nupdg = nupdg;
+	 *ntuple->nuE = nuE;
+	 *ntuple->nuPx = nuPx;
+	 *ntuple->nuPy = nuPy;
+	 *ntuple->nuPz = nuPz;
+	 *ntuple->xsection = xsection;
+	 *ntuple->IsQE = IsQE;
+	 *ntuple->IsRES = IsRES;
+	 *ntuple->IsDIS = IsDIS;
+	 *ntuple->IsCoh = IsCoh;
+	 *ntuple->IsMEC = IsMEC;
+	 *ntuple->IsCC = IsCC;
+	 *ntuple->IsNC = IsNC;
+	 *ntuple->lepIndex = lepIndex;
+	 *ntuple->lepPdg = lepPdg;
+	 *ntuple->lepE = lepE;
+	 *ntuple->q3 = q3;
+	 *ntuple->omega = omega;
+	 *ntuple->Q2 = Q2;
+	 *ntuple->W = W;
+	 *ntuple->x = x;
+	 *ntuple->y = y;
+	 *ntuple->Ehad = Ehad;
+	 *ntuple->Q2sel = Q2sel;
+	 *ntuple->Wsel = Wsel;
+	 *ntuple->xsel = xsel;
+	 *ntuple->ysel = ysel;
+	 for (size_t j = 0; j < status.size(); j++)
+	   ntuple->FillParticle(status[j], pdg[j], energy[j], px[j], py[j], pz[j]);
+	 ntuple->writer->Fill();
+       }
     }
 
-  outputFile->Write();
-  outputFile->Close();
+  if (outputFile) {
+    outputFile->Write();
+    outputFile->Close();
+    delete outputFile;
+  }
+  delete ntuple; // commits the RNTuple
+  myTree->ResetBranchAddresses();
+  delete myEventRecord;
+  myFile->Close();
+  delete myFile;
+  delete flat;
+  if (monitor) monitor->Log(last - first);
+  delete monitor;
+
+  stats.ok = true;
+  stats.nevents = last - first;
+  stats.seconds = timer.RealTime();
+  return stats;
+}
+
+// Number of gtree entries in infile, or -1 if it cannot be read. With
+// warmup, one event is read as well: GENIE fills its PDG library and other
+// singletons on first use, which is not thread safe, so this is done once
+// before any worker thread starts.
+Long64_t count_gtree_entries(const char* infile, bool warmup)
+{
+  TFile *myFile = TFile::Open(infile, "READ");
+  if (!myFile || myFile->IsZombie()) {
+    std::cerr << "Error: cannot open input file " << infile << std::endl;
+    delete myFile;
+    return -1;
+  }
+  TTree *myTree = dynamic_cast<TTree*>(myFile->Get("gtree"));
+  if (!myTree) {
+    std::cerr << "Error: could not find TTree 'gtree' in " << infile << std::endl;
+    delete myFile;
+    return -1;
+  }
+  Long64_t nentries = myTree->GetEntries();
+
+  if (warmup && nentries > 0) {
+    NtpMCEventRecord* record = new NtpMCEventRecord();
+    myTree->SetBranchAddress("gmcrec", &record);
+    myTree->GetEntry(0);
+    record->event->Probe();
+    myTree->ResetBranchAddresses();
+    delete record;
+  }
+  myFile->Close();
+  delete myFile;
+  return nentries;
+}
+
+// <name>_converted.root for <name>.root
+TString converted_name(const char* infile)
+{
+  TString outName(infile);
+  if (outName.EndsWith(".root")) outName.ReplaceAll(".root", "_converted.root");
+  else outName.Append("_converted.root");
+  return outName;
+}
+
+// Description of a conversion: input file identity (path, mtime, size,
+// entries) and the options used. It is stored in the output as the title of
+// the "ConversionInfo" TNamed once the output is complete, so an output
+// without it (e.g. after a crash) is never mistaken for a finished one.
+TString conversion_info(const char* infile, Long64_t nentries, const char* opt)
+{
+  FileStat_t st;
+  gSystem->GetPathInfo(infile, st);
+  TString o(opt);
+  o.ToLower();
+  return TString::Format("input=%s;mtime=%ld;size=%lld;entries=%lld;options=%s",
+                         infile, st.fMtime, st.fSize, nentries, o.Data());
+}
+
+// Write the skim description and the ConversionInfo record (last, see above).
+// The number of truncated events is appended to the record; it is an
+// outcome of the conversion, so is_up_to_date ignores it.
+bool write_conversion_info(const char* outName, const TString& info,
+                           const EventSelection& selection, Long64_t nselected, Long64_t nevents,
+                           Long64_t ntruncated)
+{
+  TFile f(outName, "UPDATE");
+  if (f.IsZombie()) return false;
+  TString skim = TString::Format("%s; selected %lld of %lld events",
+                                 selection.Describe().Data(), nselected, nevents);
+  TString record = info + TString::Format(";truncated=%lld", ntruncated);
+  TNamed("Selection", skim.Data()).Write("Selection", TObject::kOverwrite);
+  TNamed("ConversionInfo", record.Data()).Write("ConversionInfo", TObject::kOverwrite);
+  f.Close();
+  return true;
+}
+
+// True if outName exists and was converted from the current infile with opt
+bool is_up_to_date(const char* infile, const char* outName, const char* opt)
+{
+  if (gSystem->AccessPathName(outName)) return false; // no output yet
+  Long64_t nentries = count_gtree_entries(infile, false);
+  if (nentries < 0) return false;
+  TFile *f = TFile::Open(outName, "READ");
+  if (!f || f->IsZombie()) {
+    delete f;
+    return false;
+  }
+  TNamed *stored = dynamic_cast<TNamed*>(f->Get("ConversionInfo"));
+  bool same = false;
+  if (stored) {
+    TString title = stored->GetTitle();
+    Ssiz_t pos = title.Index(";truncated=");
+    if (pos != kNPOS) title.Remove(pos);
+    same = conversion_info(infile, nentries, opt) == title;
+  }
+  f->Close();
+  delete f;
+  return same;
+}
+
+// Convert infile into outName with nthreads threads; returns false on failure
+bool convert_file(const char* infile, const char* outName, int nthreads, const char* opt)
+{
+  ConvertOptions opts = parse_convert_options(opt);
+
+  nthreads = ResolveThreadCount(nthreads);
+  if (opts.rntuple && nthreads > 1) {
+    std::cout << "RNTuple output cannot be merged, converting on one thread" << std::endl;
+    nthreads = 1;
+  }
+
+  // Count entries once to split the work
+  Long64_t nentries = count_gtree_entries(infile, nthreads > 1);
+  if (nentries < 0) return false;
+  TString info = conversion_info(infile, nentries, opt);
+  std::vector<EntryRange> ranges = SplitEntries(nentries, nthreads);
+
+  TStopwatch total;
+  if (ranges.size() <= 1) {
+    ConvertStats stats = convert_entries(infile, outName, 0, nentries, opts);
+    if (!stats.ok) return false;
+    std::cout << "Converted " << stats.nevents << " events in " << stats.seconds
+              << " s (" << (stats.seconds > 0 ? stats.nevents/stats.seconds : 0)
+              << " events/s), kept " << stats.nselected << std::endl;
+    std::cout << "Output: " << outName << std::endl;
+    return write_conversion_info(outName, info, opts.selection, stats.nselected, stats.nevents,
+                                 stats.ntruncated);
+  }
+
+  // One temporary file per block, merged afterwards in block order
+  std::vector<TString> partNames;
+  for (size_t k = 0; k < ranges.size(); k++) {
+    TString part = outName;
+    if (part.EndsWith(".root")) part.Remove(part.Length() - 5);
+    part += TString::Format(".part%zu.root", k);
+    partNames.push_back(part);
+  }
+
+  // RSS and heap are process-wide, so with several threads they are logged
+  // once for the whole conversion instead of per range
+  opts.logRangeMemory = false;
+  MemoryMonitor *monitor = nullptr;
+  if (opts.streamBytes > 0) monitor = new MemoryMonitor("all threads");
+
+  ROOT::EnableThreadSafety();
+  std::vector<ConvertStats> stats(ranges.size());
+  ROOT::TThreadExecutor pool(ranges.size());
+  pool.Foreach([&](unsigned int k) {
+      stats[k] = convert_entries(infile, partNames[k], ranges[k].begin, ranges[k].end, opts);
+    }, ROOT::TSeqU(ranges.size()));
+
+  double convertTime = total.RealTime();
+  total.Start(kFALSE);
+  if (monitor) {
+    Long64_t nconverted = 0;
+    for (size_t k = 0; k < stats.size(); k++) nconverted += stats[k].nevents;
+    monitor->Log(nconverted);
+    delete monitor;
+  }
+
+  bool ok = true;
+  for (size_t k = 0; k < stats.size(); k++) ok = ok && stats[k].ok;
+  if (ok) {
+    TFileMerger merger(kFALSE);
+    merger.OutputFile(outName, "RECREATE", profile_compression(opts.profile));
+    for (size_t k = 0; k < partNames.size(); k++) merger.AddFile(partNames[k], kFALSE);
+    ok = merger.Merge();
+  }
+  for (size_t k = 0; k < partNames.size(); k++) gSystem->Unlink(partNames[k]);
+  if (!ok) {
+    std::cerr << "Error: could not merge thread outputs into " << outName << std::endl;
+    return false;
+  }
+
+  // Per-thread throughput, so scaling with the number of cores can be checked
+  Long64_t nconverted = 0, nselected = 0, ntruncated = 0;
+  for (size_t k = 0; k < stats.size(); k++) {
+    nconverted += stats[k].nevents;
+    nselected += stats[k].nselected;
+    ntruncated += stats[k].ntruncated;
+    std::cout << "Thread " << k << ": entries [" << ranges[k].begin << ", " << ranges[k].end
+              << "), " << (stats[k].seconds > 0 ? stats[k].nevents/stats[k].seconds : 0)
+              << " events/s" << std::endl;
+  }
+  double totalTime = total.RealTime();
+  std::cout << "Converted " << nconverted << " events with " << ranges.size() << " threads in "
+            << convertTime << " s + " << totalTime - convertTime << " s merge ("
+            << (totalTime > 0 ? nconverted/totalTime : 0) << " events/s overall), kept "
+            << nselected << std::endl;
+  std::cout << "Output: " << outName << std::endl;
+  return write_conversion_info(outName, info, opts.selection, nselected, nconverted, ntruncated);
+}
+
+// Size and read-back speed of a converted file, to compare output profiles.
+// The file was just written, so it is read from the page cache: the speed
+// measures decompression and deserialization, not the disk.
+void print_output_report(const char* outName)
+{
+  ConvertedReader reader(outName);
+  if (!reader.IsOpen() || reader.GetEntries() == 0) return;
+  Long64_t N = reader.GetEntries();
+  double fileBytes = reader.GetFile()->GetSize();
+
+  TString ratio = "n/a"; // not available for RNTuple
+  if (!reader.IsNtuple()) {
+    TTree *tevt = reader.GetEventTree(), *tpart = reader.GetParticleTree();
+    double tot = tevt->GetTotBytes(), zip = tevt->GetZipBytes();
+    if (tpart && tpart != tevt) {
+      tot += tpart->GetTotBytes();
+      zip += tpart->GetZipBytes();
+    }
+    if (zip > 0) ratio = TString::Format("%.2f", tot/zip);
+  }
+
+  TStopwatch timer;
+  for (Long64_t i = 0; i < N; i++) reader.GetEntry(i);
+  double t = timer.RealTime();
+
+  std::cout << "Output report: " << fileBytes/N << " bytes/event, compression ratio " << ratio
+            << ", read back at " << (t > 0 ? N/t : 0) << " events/s ("
+            << (t > 0 ? fileBytes/t/1e6 : 0) << " MB/s)" << std::endl;
+}
+
+void read_genie_convert_root(const char* infile, int nthreads = 1, const char* opt = "")
+{
+  TString outName = converted_name(infile);
+  if (convert_file(infile, outName, nthreads, opt)) print_output_report(outName);
+}
+
+// Convert every file matching pattern (anything TChain::Add accepts, e.g.
+// "gntp.*.ghep.root") with up to nworkers files in flight at once. Outputs
+// that are already complete for the current input and options are skipped,
+// so rerunning after a crash or a failed file only redoes what is missing.
+// If mergedOut is given, all outputs are merged into it in input order.
+void read_genie_convert_campaign(const char* pattern, int nworkers = 4,
+                                 const char* opt = "", const char* mergedOut = "")
+{
+  TChain chain("gtree");
+  chain.Add(pattern);
+  std::vector<TString> inputs;
+  TIter next(chain.GetListOfFiles());
+  while (TObject *element = next()) inputs.push_back(element->GetTitle());
+  if (inputs.empty()) {
+    std::cerr << "Error: no input files match " << pattern << std::endl;
+    return;
+  }
+
+  std::vector<size_t> todo;
+  for (size_t k = 0; k < inputs.size(); k++) {
+    if (is_up_to_date(inputs[k], converted_name(inputs[k]), opt))
+      std::cout << "Up to date: " << converted_name(inputs[k]) << std::endl;
+    else
+      todo.push_back(k);
+  }
+  std::cout << inputs.size() << " input files, " << todo.size() << " to convert" << std::endl;
+
+  std::vector<char> failed(inputs.size(), 0);
+  if (!todo.empty()) {
+    // Same warm-up as for block conversion, the workers share GENIE's singletons
+    count_gtree_entries(inputs[todo[0]], true);
+    ROOT::EnableThreadSafety();
+    ROOT::TThreadExecutor pool(ResolveThreadCount(nworkers));
+    pool.Foreach([&](size_t k) {
+        if (!convert_file(inputs[k], converted_name(inputs[k]), 1, opt)) failed[k] = 1;
+      }, todo);
+  }
+
+  int nfailed = 0;
+  for (size_t k = 0; k < inputs.size(); k++) {
+    if (!failed[k]) continue;
+    std::cerr << "Failed: " << inputs[k] << std::endl;
+    nfailed++;
+  }
+  if (nfailed > 0) {
+    std::cerr << nfailed << " files failed; rerun to retry only those" << std::endl;
+    return;
+  }
+
+  if (TString(mergedOut).IsNull()) return;
+  if (parse_convert_options(opt).rntuple) {
+    std::cerr << "Error: RNTuple outputs cannot be merged" << std::endl;
+    return;
+  }
+  // The per-file ConversionInfo and Selection records do not describe the
+  // merged file; they are skipped and one campaign record is written instead
+  ConvertOptions opts = parse_convert_options(opt);
+  TFileMerger merger(kFALSE);
+  merger.OutputFile(mergedOut, "RECREATE", profile_compression(opts.profile));
+  merger.AddObjectNames("ConversionInfo Selection");
+  Long64_t nevents = 0, nselected = 0, ntruncated = 0;
+  for (size_t k = 0; k < inputs.size(); k++) {
+    merger.AddFile(converted_name(inputs[k]), kFALSE);
+    nevents += count_gtree_entries(inputs[k], false);
+    ConvertedReader part(converted_name(inputs[k]), ConvertedReader::kNoParticles);
+    nselected += part.GetEntries();
+    ntruncated += part.GetTruncatedEntries();
+  }
+  if (!merger.PartialMerge(TFileMerger::kAll | TFileMerger::kRegular | TFileMerger::kSkipListed)) {
+    std::cerr << "Error: could not merge outputs into " << mergedOut << std::endl;
+    return;
+  }
+  TString o(opt);
+  o.ToLower();
+  TString info = TString::Format("campaign=%s;files=%zu;entries=%lld;options=%s",
+                                 pattern, inputs.size(), nevents, o.Data());
+  if (write_conversion_info(mergedOut, info, opts.selection, nselected, nevents, ntruncated))
+    std::cout << "Merged output: " << mergedOut << std::endl;
+  else
+    std::cerr << "Error: could not write the campaign record to " << mergedOut << std::endl;
 }